@@ -0,0 +1,26 @@
+#ifndef BJG_DETAIL_ALLOCATOR_UTILS_HPP
+#define BJG_DETAIL_ALLOCATOR_UTILS_HPP
+
+#include <type_traits>
+#include <utility>
+
+namespace bjg {
+namespace detail {
+
+/**
+ * @brief Swaps two allocators when @p propagate is std::true_type, as selected by one of the propagate_on_container_*
+ * allocator traits. Otherwise the allocators are left in place, which also supports allocators that are not assignable.
+ */
+template <class Allocator>
+void swap_allocators(Allocator &lhs, Allocator &rhs, std::true_type /*propagate*/) noexcept {
+    using std::swap;
+    swap(lhs, rhs);
+}
+
+template <class Allocator>
+void swap_allocators(Allocator & /*lhs*/, Allocator & /*rhs*/, std::false_type /*propagate*/) noexcept {}
+
+}  // namespace detail
+}  // namespace bjg
+
+#endif
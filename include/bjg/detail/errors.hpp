@@ -0,0 +1,64 @@
+#ifndef BJG_DETAIL_ERRORS_HPP
+#define BJG_DETAIL_ERRORS_HPP
+
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+
+// Builds without exceptions when they are disabled, as with -fno-exceptions, or when BJG_LRU_CACHE_NO_EXCEPTIONS is defined
+#if !defined(BJG_LRU_CACHE_NO_EXCEPTIONS) && !defined(__cpp_exceptions) && !defined(__EXCEPTIONS) && !defined(_CPPUNWIND)
+#define BJG_LRU_CACHE_NO_EXCEPTIONS
+#endif
+
+namespace bjg {
+namespace detail {
+
+/**
+ * @brief Raises std::length_error, or aborts in a build without exceptions.
+ */
+[[noreturn]] inline void throw_length_error(const char *what) {
+#ifdef BJG_LRU_CACHE_NO_EXCEPTIONS
+    (void)what;
+    std::abort();
+#else
+    throw std::length_error{what};
+#endif
+}
+
+/**
+ * @brief Raises std::out_of_range, or aborts in a build without exceptions.
+ */
+[[noreturn]] inline void throw_out_of_range(const char *what) {
+#ifdef BJG_LRU_CACHE_NO_EXCEPTIONS
+    (void)what;
+    std::abort();
+#else
+    throw std::out_of_range{what};
+#endif
+}
+
+/**
+ * @brief Raises std::bad_alloc, or aborts in a build without exceptions.
+ */
+[[noreturn]] inline void throw_bad_alloc() {
+#ifdef BJG_LRU_CACHE_NO_EXCEPTIONS
+    std::abort();
+#else
+    throw std::bad_alloc{};
+#endif
+}
+
+/**
+ * @brief Returns memory returned by an allocator, raising std::bad_alloc if it is nullptr, as allocators which do not throw
+ * return on failure.
+ */
+template <class T>
+T *checked_allocation(T *memory) {
+    if (memory == nullptr) throw_bad_alloc();
+    return memory;
+}
+
+}  // namespace detail
+}  // namespace bjg
+
+#endif
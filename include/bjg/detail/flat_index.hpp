@@ -0,0 +1,802 @@
+#ifndef BJG_DETAIL_FLAT_INDEX_HPP
+#define BJG_DETAIL_FLAT_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include "bjg/detail/allocator_utils.hpp"
+#include "bjg/detail/errors.hpp"
+#include "bjg/detail/guarded_scope.hpp"
+#include "bjg/detail/prefetch.hpp"
+
+#if !defined(BJG_LRU_CACHE_NO_SSE2) && \
+    (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define BJG_LRU_CACHE_HAVE_SSE2 1
+#include <emmintrin.h>
+#else
+#define BJG_LRU_CACHE_HAVE_SSE2 0
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace bjg {
+namespace detail {
+
+/**
+ * @brief Control byte of a flat index bucket. A full bucket holds the low 7 bits of its key's hash, an empty or deleted
+ * bucket has the sign bit set.
+ */
+using ctrl_t = signed char;
+
+constexpr ctrl_t ctrl_empty = -128;
+constexpr ctrl_t ctrl_deleted = -2;
+
+/**
+ * @brief Mixes the bits of a user provided hash. The index only works with mixed hashes: std::hash is the identity for
+ * integers, so without mixing, sequential keys would all fall into the same probe groups.
+ */
+inline std::size_t mix_hash(std::size_t hash) noexcept {
+#if SIZE_MAX > UINT32_MAX
+    hash *= static_cast<std::size_t>(0x9E3779B97F4A7C15ULL);
+    return hash ^ (hash >> 32);
+#else
+    hash *= static_cast<std::size_t>(0x9E3779B9UL);
+    return hash ^ (hash >> 16);
+#endif
+}
+
+/**
+ * @brief Returns the index of the lowest set bit of @p bits.
+ *
+ * @pre @p bits must not be zero.
+ */
+inline unsigned count_trailing_zeros(const std::uint32_t bits) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_ctz(bits));
+#elif defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanForward(&index, bits);
+    return static_cast<unsigned>(index);
+#else
+    unsigned index = 0;
+    while ((bits & (1u << index)) == 0) ++index;
+    return index;
+#endif
+}
+
+/**
+ * @brief Set of bucket positions within a probe group, one bit per bucket.
+ */
+class probe_mask {
+   public:
+    explicit probe_mask(const std::uint32_t bits) noexcept : bits_{bits} {}
+
+    explicit operator bool() const noexcept { return bits_ != 0; }
+
+    unsigned lowest() const noexcept { return count_trailing_zeros(bits_); }
+
+    void clear_lowest() noexcept { bits_ &= bits_ - 1; }
+
+   private:
+    std::uint32_t bits_;
+};
+
+/**
+ * @brief Group of 16 control bytes which are matched together, with SSE2 when available and byte by byte otherwise.
+ */
+class ctrl_group {
+   public:
+    static constexpr std::size_t width = 16;
+
+#if BJG_LRU_CACHE_HAVE_SSE2
+    explicit ctrl_group(const ctrl_t *ctrl) noexcept
+        : ctrl_{_mm_load_si128(static_cast<const __m128i *>(static_cast<const void *>(ctrl)))} {}
+
+    probe_mask match(const ctrl_t h2) const noexcept {
+        const auto matches = _mm_cmpeq_epi8(_mm_set1_epi8(static_cast<char>(h2)), ctrl_);
+        return probe_mask{static_cast<std::uint32_t>(_mm_movemask_epi8(matches))};
+    }
+
+    probe_mask match_empty() const noexcept { return match(ctrl_empty); }
+
+    probe_mask match_empty_or_deleted() const noexcept {
+        return probe_mask{static_cast<std::uint32_t>(_mm_movemask_epi8(ctrl_))};
+    }
+
+   private:
+    __m128i ctrl_;
+#else
+    explicit ctrl_group(const ctrl_t *ctrl) noexcept { std::memcpy(ctrl_, ctrl, width); }
+
+    probe_mask match(const ctrl_t h2) const noexcept {
+        std::uint32_t bits = 0;
+        for (std::size_t i = 0; i < width; ++i) {
+            if (ctrl_[i] == h2) bits |= 1u << i;
+        }
+        return probe_mask{bits};
+    }
+
+    probe_mask match_empty() const noexcept { return match(ctrl_empty); }
+
+    probe_mask match_empty_or_deleted() const noexcept {
+        std::uint32_t bits = 0;
+        for (std::size_t i = 0; i < width; ++i) {
+            if (ctrl_[i] < 0) bits |= 1u << i;
+        }
+        return probe_mask{bits};
+    }
+
+   private:
+    ctrl_t ctrl_[width];
+#endif
+};
+/**
+ * @brief Checks if @p count slots leave enough free buckets among @p bucket_count to drop the deleted buckets in place
+ * instead of growing.
+ */
+constexpr bool fits_in_place(const std::size_t count, const std::size_t bucket_count) noexcept {
+    return count * 32 <= bucket_count * 25;
+}
+
+/**
+ * @brief Returns the fewest buckets, at least @p bucket_count, which can hold @p count slots while dropping the deleted
+ * buckets in place.
+ */
+constexpr std::size_t in_place_bucket_count(const std::size_t count, const std::size_t bucket_count) noexcept {
+    return fits_in_place(count, bucket_count) ? bucket_count : in_place_bucket_count(count, bucket_count * 2);
+}
+
+/**
+ * @brief Open addressing hash index which maps hashed keys to the slots where the caller stores them. Buckets are split
+ * into groups of 16 whose control bytes hold a 7 bit fingerprint of the key's hash, so a probe compares a whole group at
+ * once and only looks at the slots whose fingerprint matches. Groups are visited in triangular order, which covers the whole
+ * table as the number of groups is a power of two.
+ *
+ * The index stores neither keys nor hashes. The caller passes the mixed hash of each key, compares the keys stored in the
+ * candidate slots and, when the buckets must be rebuilt, provides the hash it stored for each slot. The operations also take
+ * the key itself, which this index ignores, so that it shares its interface with integer_index.
+ *
+ * The buckets are owned by @p Derived, which provides rehash_for_insert, called when an insertion finds no free bucket.
+ *
+ * @tparam Derived The index type which owns the buckets.
+ * @tparam Slot The unsigned integer type of the slots. Its maximum value is reserved for no_slot.
+ */
+template <class Derived, class Slot>
+class flat_index_base {
+   public:
+    using size_type = std::size_t;
+
+    /**
+     * @brief Bucket returned when no bucket is found.
+     */
+    static constexpr size_type npos = static_cast<size_type>(-1);
+
+    /**
+     * @brief Slot returned when a key does not exist.
+     */
+    static constexpr Slot no_slot = static_cast<Slot>(-1);
+
+    /**
+     * @brief Whether the index places the keys by the hashes it is given, which the caller must then compute.
+     */
+    static constexpr bool hashes_keys = true;
+
+    /**
+     * @brief Outcome of a lookup which prepares the insertion of the key if it does not exist.
+     */
+    struct insert_position {
+        /**
+         * @brief The slot of the key or no_slot if the key does not exist.
+         */
+        Slot slot;
+
+        /**
+         * @brief The bucket where the key can be inserted if it does not exist, or npos if the buckets must grow first.
+         */
+        size_type bucket;
+    };
+
+    bool empty() const noexcept { return size_ == 0; }
+
+    size_type size() const noexcept { return size_; }
+
+    /**
+     * @brief Finds the slot of a key.
+     *
+     * @param hash The mixed hash of the key.
+     * @param matches Returns true if the key stored in the given slot is the searched one. The key itself is only compared by
+     * @p matches.
+     *
+     * @return The slot of the key or no_slot if the key does not exist.
+     */
+    template <class K, class Matches>
+    Slot find(const K & /*key*/, const std::size_t hash, Matches matches) const {
+        if (size_ == 0) return no_slot;
+
+        auto found = no_slot;
+        probe(hash, [this, &matches, &found, hash](const size_type first) {
+            const ctrl_group group{ctrl_ + first};
+            for (auto match = group.match(h2(hash)); match; match.clear_lowest()) {
+                const auto slot = slots_[first + match.lowest()];
+                if (matches(slot)) {
+                    found = slot;
+                    return true;
+                }
+            }
+            return static_cast<bool>(group.match_empty());
+        });
+        return found;
+    }
+
+    /**
+     * @brief Prefetches the first group probed for a key, its control bytes and its slots.
+     *
+     * @param hash The mixed hash of the key.
+     */
+    template <class K>
+    void prefetch(const K & /*key*/, const std::size_t hash) const noexcept {
+        if (bucket_count_ == 0) return;
+
+        const auto first = ((hash >> 7) & (bucket_count_ / ctrl_group::width - 1)) * ctrl_group::width;
+        detail::prefetch(ctrl_ + first);
+        detail::prefetch(slots_ + first);
+    }
+
+    /**
+     * @brief Returns the first slot of the first probed group whose fingerprint matches a key, without comparing keys, so the
+     * caller can prefetch the item before it is compared.
+     *
+     * @param hash The mixed hash of the key.
+     *
+     * @return The slot which most likely holds the key, or no_slot if the first group has no candidate.
+     */
+    template <class K>
+    Slot candidate(const K & /*key*/, const std::size_t hash) const noexcept {
+        if (size_ == 0) return no_slot;
+
+        const auto first = ((hash >> 7) & (bucket_count_ / ctrl_group::width - 1)) * ctrl_group::width;
+        const auto match = ctrl_group{ctrl_ + first}.match(h2(hash));
+        return match ? slots_[first + match.lowest()] : no_slot;
+    }
+
+    /**
+     * @brief Finds the slot of a key and, in the same probe, the first free bucket where the key can be inserted.
+     *
+     * @param hash The mixed hash of the key.
+     * @param matches Returns true if the key stored in the given slot is the searched one. The key itself is only compared by
+     * @p matches.
+     *
+     * @return The slot of the key and the bucket where it can be inserted.
+     */
+    template <class K, class Matches>
+    insert_position find_or_prepare_insert(const K & /*key*/, const std::size_t hash, Matches matches) const {
+        insert_position position{no_slot, npos};
+        if (bucket_count_ == 0) return position;
+
+        probe(hash, [this, &matches, &position, hash](const size_type first) {
+            const ctrl_group group{ctrl_ + first};
+            for (auto match = group.match(h2(hash)); match; match.clear_lowest()) {
+                const auto slot = slots_[first + match.lowest()];
+                if (matches(slot)) {
+                    position.slot = slot;
+                    return true;
+                }
+            }
+            if (position.bucket == npos) {
+                const auto free = group.match_empty_or_deleted();
+                if (free) position.bucket = first + free.lowest();
+            }
+            return static_cast<bool>(group.match_empty());
+        });
+        return position;
+    }
+
+    /**
+     * @brief Indexes the slot of a key at the bucket prepared by find_or_prepare_insert. The bucket stays valid as long as
+     * the index is not modified in between.
+     *
+     * @param bucket The bucket returned by find_or_prepare_insert.
+     * @param hash The mixed hash of the key.
+     * @param slot The slot where the key is stored.
+     * @param hash_of Returns the mixed hash of the key stored in an indexed slot. It is only called if the buckets are rebuilt
+     * and it must not throw.
+     * @pre The key must not exist in the index.
+     */
+    template <class K, class HashOf>
+    void insert_at(size_type bucket, const K &key, const std::size_t hash, const Slot slot, HashOf hash_of) {
+        fill(prepare_insert(bucket, key, hash, hash_of), hash, slot);
+    }
+
+    /**
+     * @brief Makes room for a key at the bucket prepared by find_or_prepare_insert, rebuilding the buckets if the key does
+     * not fit. It is the only step of an insertion which can throw, so the caller can take it before storing the key.
+     *
+     * @param bucket The bucket returned by find_or_prepare_insert.
+     * @param hash The mixed hash of the key.
+     * @param hash_of Returns the mixed hash of the key stored in an indexed slot, as for insert_at.
+     *
+     * @return The bucket to pass to insert_at, which then does not grow as long as the index is not modified in between.
+     */
+    template <class K, class HashOf>
+    size_type prepare_insert(const size_type bucket, const K & /*key*/, const std::size_t hash, HashOf hash_of) {
+        if (bucket != npos && (growth_left_ != 0 || ctrl_[bucket] != ctrl_empty)) return bucket;
+
+        static_cast<Derived &>(*this).rehash_for_insert(hash_of);
+        return find_free_bucket(hash);
+    }
+
+    /**
+     * @brief Indexes the slot of a key, as insert_at does, right after another key was erased. The index holds fewer slots
+     * than its buckets ever held, so dropping the deleted buckets in place always makes room and it never grows.
+     *
+     * @param bucket The bucket returned by find_or_prepare_insert after the erasure.
+     */
+    template <class K, class HashOf>
+    void reinsert_at(size_type bucket, const K & /*key*/, const std::size_t hash, const Slot slot, HashOf hash_of) noexcept {
+        if (growth_left_ == 0 && ctrl_[bucket] == ctrl_empty) {
+            rehash_in_place(hash_of);
+            bucket = find_free_bucket(hash);
+        }
+        fill(bucket, hash, slot);
+    }
+
+    /**
+     * @brief Removes the slot of a key. The bucket is found by comparing slots, so no key is compared.
+     *
+     * @param hash The mixed hash of the key.
+     * @param slot The indexed slot of the key.
+     * @pre @p slot must be indexed with @p hash.
+     */
+    template <class K>
+    void erase(const K & /*key*/, const std::size_t hash, const Slot slot) noexcept {
+        auto found = npos;
+        probe(hash, [this, &found, slot, hash](const size_type first) {
+            for (auto match = ctrl_group{ctrl_ + first}.match(h2(hash)); match; match.clear_lowest()) {
+                if (slots_[first + match.lowest()] == slot) {
+                    found = first + match.lowest();
+                    return true;
+                }
+            }
+            return false;
+        });
+
+        // A probe stops at the first group with an empty bucket, so the bucket can only become empty again if its group
+        // already stops the probes going through it.
+        if (ctrl_group{ctrl_ + group_start(found)}.match_empty()) {
+            ctrl_[found] = ctrl_empty;
+            ++growth_left_;
+        } else {
+            ctrl_[found] = ctrl_deleted;
+        }
+        --size_;
+    }
+
+    /**
+     * @brief Replaces the slot of a key by the slot of an equal key, in the same bucket.
+     *
+     * @param hash The mixed hash of both keys.
+     * @param slot The indexed slot to replace.
+     * @param replacement The new slot.
+     * @pre @p slot must be indexed with @p hash.
+     */
+    void replace(const std::size_t hash, const Slot slot, const Slot replacement) noexcept {
+        probe(hash, [this, slot, replacement, hash](const size_type first) {
+            for (auto match = ctrl_group{ctrl_ + first}.match(h2(hash)); match; match.clear_lowest()) {
+                if (slots_[first + match.lowest()] == slot) {
+                    slots_[first + match.lowest()] = replacement;
+                    return true;
+                }
+            }
+            return false;
+        });
+    }
+
+    /**
+     * @brief Removes all the slots. The index keeps its buckets and empties all their control bytes, in a time linear in the
+     * number of buckets.
+     */
+    void clear() noexcept {
+        if (bucket_count_ != 0) std::memset(ctrl_, ctrl_empty, bucket_count_);
+        size_ = 0;
+        growth_left_ = max_load(bucket_count_);
+    }
+
+   protected:
+    struct alignas(ctrl_group::width) ctrl_block {
+        ctrl_t ctrl[ctrl_group::width];
+    };
+
+    flat_index_base() = default;
+    flat_index_base(const flat_index_base &) = delete;
+    flat_index_base &operator=(const flat_index_base &) = delete;
+    ~flat_index_base() = default;
+
+    static ctrl_t h2(const std::size_t hash) noexcept { return static_cast<ctrl_t>(hash & 0x7F); }
+
+    void fill(const size_type bucket, const std::size_t hash, const Slot slot) noexcept {
+        if (ctrl_[bucket] == ctrl_empty) --growth_left_;
+        ctrl_[bucket] = h2(hash);
+        slots_[bucket] = slot;
+        ++size_;
+    }
+
+    static constexpr size_type max_load(const size_type bucket_count) noexcept { return bucket_count - bucket_count / 8; }
+
+    static size_type group_start(const size_type bucket) noexcept { return bucket & ~(ctrl_group::width - 1); }
+
+    /**
+     * @brief Calls @p f with the first bucket of each group in the probe sequence of @p hash until it returns true.
+     */
+    template <class F>
+    void probe(const std::size_t hash, F f) const {
+        const auto group_mask = bucket_count_ / ctrl_group::width - 1;
+        auto group = (hash >> 7) & group_mask;
+        for (size_type step = 1; !f(group * ctrl_group::width); ++step) group = (group + step) & group_mask;
+    }
+
+    size_type find_free_bucket(const std::size_t hash) const noexcept {
+        if (bucket_count_ == 0) return npos;
+
+        auto found = npos;
+        probe(hash, [this, &found](const size_type first) {
+            const auto match = ctrl_group{ctrl_ + first}.match_empty_or_deleted();
+            if (match) found = first + match.lowest();
+            return static_cast<bool>(match);
+        });
+        return found;
+    }
+
+    /**
+     * @brief Drops the deleted buckets without allocating. Every full bucket is marked deleted and the deleted ones are
+     * emptied. Then each marked bucket is moved to the first free bucket of its probe sequence, unless that bucket is in its
+     * own group. A marked bucket displaced by a move takes its place and is processed in turn.
+     */
+    template <class HashOf>
+    void rehash_in_place(HashOf hash_of) noexcept {
+        for (size_type i = 0; i < bucket_count_; ++i) ctrl_[i] = ctrl_[i] >= 0 ? ctrl_deleted : ctrl_empty;
+
+        size_type i = 0;
+        while (i < bucket_count_) {
+            if (ctrl_[i] != ctrl_deleted) {
+                ++i;
+                continue;
+            }
+
+            const auto hash = hash_of(slots_[i]);
+            const auto target = find_free_bucket(hash);
+            if (group_start(target) == group_start(i)) {
+                ctrl_[i] = h2(hash);
+                ++i;
+            } else if (ctrl_[target] == ctrl_empty) {
+                ctrl_[target] = h2(hash);
+                slots_[target] = slots_[i];
+                ctrl_[i] = ctrl_empty;
+                ++i;
+            } else {
+                ctrl_[target] = h2(hash);
+                std::swap(slots_[target], slots_[i]);
+            }
+        }
+        growth_left_ = max_load(bucket_count_) - size_;
+    }
+
+    /**
+     * @brief Copies the buckets of @p other into the buckets of this index, which must have the same count.
+     */
+    void copy_buckets(const flat_index_base &other) noexcept {
+        if (other.bucket_count_ == 0) return;
+
+        std::memcpy(ctrl_, other.ctrl_, other.bucket_count_);
+        std::memcpy(slots_, other.slots_, other.bucket_count_ * sizeof(Slot));
+        size_ = other.size_;
+        growth_left_ = other.growth_left_;
+    }
+
+    void swap_buckets(flat_index_base &other) noexcept {
+        std::swap(ctrl_, other.ctrl_);
+        std::swap(slots_, other.slots_);
+        std::swap(bucket_count_, other.bucket_count_);
+        std::swap(size_, other.size_);
+        std::swap(growth_left_, other.growth_left_);
+    }
+
+    ctrl_t *ctrl_{nullptr};
+    Slot *slots_{nullptr};
+    size_type bucket_count_{0};
+    size_type size_{0};
+    size_type growth_left_{0};
+};
+
+template <class Derived, class Slot>
+constexpr typename flat_index_base<Derived, Slot>::size_type flat_index_base<Derived, Slot>::npos;
+
+template <class Derived, class Slot>
+constexpr Slot flat_index_base<Derived, Slot>::no_slot;
+
+template <class Derived, class Slot>
+constexpr bool flat_index_base<Derived, Slot>::hashes_keys;
+
+/**
+ * @brief Flat index whose buckets are allocated on the heap. The buckets are doubled when they are mostly full, otherwise
+ * the deleted buckets are dropped in place, without allocating.
+ *
+ * @tparam Slot The unsigned integer type of the slots.
+ * @tparam Allocator An allocator rebound to allocate the buckets. It must use raw pointers.
+ */
+template <class Slot, class Allocator = std::allocator<Slot>>
+class flat_index : public flat_index_base<flat_index<Slot, Allocator>, Slot> {
+    using base = flat_index_base<flat_index<Slot, Allocator>, Slot>;
+    friend base;
+
+   public:
+    using typename base::size_type;
+    using allocator_type = Allocator;
+
+    explicit flat_index(const Allocator &alloc = Allocator()) noexcept : alloc_(alloc) {}
+
+    flat_index(const flat_index &other) : flat_index(other, traits::select_on_container_copy_construction(other.alloc_)) {}
+
+    flat_index(const flat_index &other, const Allocator &alloc) : alloc_(alloc) { copy_from(other); }
+
+    flat_index(flat_index &&other) noexcept : alloc_(std::move(other.alloc_)) { this->swap_buckets(other); }
+
+    flat_index(flat_index &&other, const Allocator &alloc) : alloc_(alloc) {
+        if (alloc_ == other.alloc_) {
+            this->swap_buckets(other);
+        } else {
+            copy_from(other);
+        }
+    }
+
+    flat_index &operator=(const flat_index &other) {
+        if (this != &other) {
+            flat_index copy{other, traits::propagate_on_container_copy_assignment::value ? other.alloc_ : alloc_};
+            this->swap_buckets(copy);
+            swap_allocators(alloc_, copy.alloc_, typename traits::propagate_on_container_copy_assignment{});
+        }
+        return *this;
+    }
+
+    flat_index &operator=(flat_index &&other) noexcept(traits::propagate_on_container_move_assignment::value) {
+        if (this != &other) {
+            flat_index moved{std::move(other), traits::propagate_on_container_move_assignment::value ? other.alloc_ : alloc_};
+            this->swap_buckets(moved);
+            swap_allocators(alloc_, moved.alloc_, typename traits::propagate_on_container_move_assignment{});
+        }
+        return *this;
+    }
+
+    ~flat_index() { deallocate(alloc_, this->ctrl_, this->slots_, this->bucket_count_); }
+
+    /**
+     * @brief Swaps the content of two indices. The allocators are swapped only if they propagate on swap, otherwise they must
+     * be equal.
+     */
+    void swap(flat_index &other) noexcept {
+        this->swap_buckets(other);
+        swap_allocators(alloc_, other.alloc_, typename traits::propagate_on_container_swap{});
+    }
+
+    allocator_type get_allocator() const noexcept { return alloc_; }
+
+    /**
+     * @brief Allocates enough buckets to hold @p count slots without growing again.
+     *
+     * @param count The number of slots to make room for.
+     * @param hash_of Returns the mixed hash of the key stored in an indexed slot. It must not throw.
+     */
+    template <class HashOf>
+    void reserve(const size_type count, HashOf hash_of) {
+        if (!try_reserve(count, hash_of)) throw_bad_alloc();
+    }
+
+    /**
+     * @brief Allocates enough buckets to hold @p count slots, as reserve does, but reports an allocator returning nullptr
+     * instead of raising std::bad_alloc.
+     *
+     * @return false if the allocation failed, in which case the index is left unchanged.
+     */
+    template <class HashOf>
+    bool try_reserve(const size_type count, HashOf hash_of) {
+        const auto bucket_count = in_place_bucket_count(count, ctrl_group::width);
+        return bucket_count <= this->bucket_count_ || try_rehash(bucket_count, hash_of);
+    }
+
+   private:
+    using ctrl_block = typename base::ctrl_block;
+    using traits = std::allocator_traits<Allocator>;
+    using ctrl_allocator = typename traits::template rebind_alloc<ctrl_block>;
+    using slot_allocator = typename traits::template rebind_alloc<Slot>;
+
+    /**
+     * @brief Allocates the control bytes and the slots of @p bucket_count buckets. If the allocator returns nullptr for
+     * either block, no block is kept and both returned blocks are nullptr.
+     */
+    static std::pair<ctrl_t *, Slot *> allocate(const Allocator &alloc, const size_type bucket_count) {
+        const auto blocks = bucket_count / ctrl_group::width;
+        ctrl_allocator ctrl_alloc(alloc);
+        auto *const ctrl = reinterpret_cast<ctrl_t *>(std::allocator_traits<ctrl_allocator>::allocate(ctrl_alloc, blocks));
+        if (ctrl == nullptr) return std::pair<ctrl_t *, Slot *>(nullptr, nullptr);
+
+        auto guard = make_guarded_scope([&ctrl_alloc, ctrl, blocks]() {
+            std::allocator_traits<ctrl_allocator>::deallocate(ctrl_alloc, reinterpret_cast<ctrl_block *>(ctrl), blocks);
+        });
+        slot_allocator slot_alloc(alloc);
+        auto *const slots = std::allocator_traits<slot_allocator>::allocate(slot_alloc, bucket_count);
+        if (slots == nullptr) return std::pair<ctrl_t *, Slot *>(nullptr, nullptr);
+
+        guard.dismiss();
+        return std::make_pair(ctrl, slots);
+    }
+
+    static void deallocate(const Allocator &alloc, ctrl_t *ctrl, Slot *slots, const size_type bucket_count) noexcept {
+        if (bucket_count == 0) return;
+
+        ctrl_allocator ctrl_alloc(alloc);
+        std::allocator_traits<ctrl_allocator>::deallocate(ctrl_alloc, reinterpret_cast<ctrl_block *>(ctrl),
+                                                          bucket_count / ctrl_group::width);
+        slot_allocator slot_alloc(alloc);
+        std::allocator_traits<slot_allocator>::deallocate(slot_alloc, slots, bucket_count);
+    }
+
+    /**
+     * @brief Allocates as many buckets as @p other has and copies them. This index must be empty.
+     */
+    void copy_from(const flat_index &other) {
+        if (other.bucket_count_ == 0) return;
+
+        auto buckets = allocate(alloc_, other.bucket_count_);
+        this->ctrl_ = checked_allocation(buckets.first);
+        this->slots_ = buckets.second;
+        this->bucket_count_ = other.bucket_count_;
+        this->copy_buckets(other);
+    }
+
+    /**
+     * @brief Makes room for a new slot. The buckets are doubled when they are mostly full, otherwise the deleted buckets are
+     * dropped in place, without allocating.
+     */
+    template <class HashOf>
+    void rehash_for_insert(HashOf hash_of) {
+        if (this->bucket_count_ == 0) {
+            rehash(ctrl_group::width, hash_of);
+        } else if (fits_in_place(this->size_ + 1, this->bucket_count_)) {
+            this->rehash_in_place(hash_of);
+        } else {
+            rehash(this->bucket_count_ * 2, hash_of);
+        }
+    }
+
+    /**
+     * @brief Copies the slots into @p bucket_count new buckets. The slots are placed using their stored hashes, so no key is
+     * hashed again.
+     */
+    template <class HashOf>
+    void rehash(const size_type bucket_count, HashOf hash_of) {
+        if (!try_rehash(bucket_count, hash_of)) throw_bad_alloc();
+    }
+
+    /**
+     * @brief Copies the slots into @p bucket_count new buckets, as rehash does.
+     *
+     * @return false if the allocator returned nullptr, in which case the index is left unchanged.
+     */
+    template <class HashOf>
+    bool try_rehash(const size_type bucket_count, HashOf hash_of) {
+        auto buckets = allocate(alloc_, bucket_count);
+        if (buckets.first == nullptr) return false;
+
+        flat_index rebuilt{alloc_};
+        rebuilt.ctrl_ = buckets.first;
+        rebuilt.slots_ = buckets.second;
+        rebuilt.bucket_count_ = bucket_count;
+        rebuilt.growth_left_ = base::max_load(bucket_count);
+        std::memset(rebuilt.ctrl_, ctrl_empty, bucket_count);
+
+        for (size_type i = 0; i < this->bucket_count_; ++i) {
+            if (this->ctrl_[i] < 0) continue;
+
+            const auto hash = hash_of(this->slots_[i]);
+            const auto bucket = rebuilt.find_free_bucket(hash);
+            rebuilt.ctrl_[bucket] = base::h2(hash);
+            rebuilt.slots_[bucket] = this->slots_[i];
+            --rebuilt.growth_left_;
+            ++rebuilt.size_;
+        }
+        this->swap_buckets(rebuilt);
+        return true;
+    }
+
+    Allocator alloc_;
+};
+
+/**
+ * @brief Flat index holding its buckets inline, so it never allocates. It has the fewest buckets which can hold
+ * @p MaxSize slots while dropping the deleted buckets in place, so it never has to grow.
+ *
+ * @tparam Slot The unsigned integer type of the slots.
+ * @tparam MaxSize The maximum number of slots.
+ */
+template <class Slot, std::size_t MaxSize>
+class static_flat_index : public flat_index_base<static_flat_index<Slot, MaxSize>, Slot> {
+    using base = flat_index_base<static_flat_index<Slot, MaxSize>, Slot>;
+    friend base;
+
+   public:
+    using typename base::size_type;
+
+    /**
+     * @brief The number of buckets.
+     */
+    static constexpr size_type bucket_count = in_place_bucket_count(MaxSize, ctrl_group::width);
+
+    static_flat_index() noexcept {
+        reset_buckets();
+        this->clear();
+    }
+
+    static_flat_index(const static_flat_index &other) noexcept {
+        reset_buckets();
+        this->copy_buckets(other);
+    }
+
+    /**
+     * @brief Copies the buckets of @p other, which is left empty like a moved-from slab.
+     */
+    static_flat_index(static_flat_index &&other) noexcept : static_flat_index{other} { other.clear(); }
+
+    static_flat_index &operator=(const static_flat_index &other) noexcept {
+        if (this != &other) this->copy_buckets(other);
+        return *this;
+    }
+
+    static_flat_index &operator=(static_flat_index &&other) noexcept {
+        if (this != &other) {
+            this->copy_buckets(other);
+            other.clear();
+        }
+        return *this;
+    }
+
+    ~static_flat_index() = default;
+
+    /**
+     * @brief Does nothing, the buckets can always hold MaxSize slots.
+     */
+    template <class HashOf>
+    void reserve(size_type /*count*/, HashOf /*hash_of*/) noexcept {}
+
+   private:
+    using ctrl_block = typename base::ctrl_block;
+
+    void reset_buckets() noexcept {
+        this->ctrl_ = ctrl_storage_[0].ctrl;
+        this->slots_ = slots_storage_;
+        this->bucket_count_ = bucket_count;
+    }
+
+    /**
+     * @brief Drops the deleted buckets in place. The buckets always fit MaxSize slots.
+     */
+    template <class HashOf>
+    void rehash_for_insert(HashOf hash_of) noexcept {
+        this->rehash_in_place(hash_of);
+    }
+
+    ctrl_block ctrl_storage_[bucket_count / ctrl_group::width];
+    Slot slots_storage_[bucket_count];
+};
+
+template <class Slot, std::size_t MaxSize>
+constexpr typename static_flat_index<Slot, MaxSize>::size_type static_flat_index<Slot, MaxSize>::bucket_count;
+
+}  // namespace detail
+}  // namespace bjg
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef BJG_DETAIL_GUARDED_SCOPE_HPP
+#define BJG_DETAIL_GUARDED_SCOPE_HPP
+
+#include <type_traits>
+#include <utility>
+
+namespace bjg {
+namespace detail {
+
+/**
+ * This is a simpler version for the GuardedScope mechanism presented here:
+ * https://www.drdobbs.com/cpp/generic-change-the-way-you-write-excepti/184403758 If you already have a pattern/mechanism in
+ * your project for handling this situation, please consider adapting the lru_cache according to your project and drop this
+ * one.
+ *
+ * @tparam F The type of the function to be called on scope exit. This function must not throw.
+ */
+template <typename F>
+class guarded_scope {
+   public:
+    explicit guarded_scope(F &&f) noexcept : f_(std::move(f)), dismiss_{false} {}
+
+    guarded_scope(guarded_scope &&other) noexcept : f_(std::move(other.f_)), dismiss_{other.dismiss_} { other.dismiss(); }
+
+    guarded_scope(const guarded_scope &) = delete;
+    guarded_scope &operator=(const guarded_scope &) = delete;
+    guarded_scope &operator=(guarded_scope &&) = delete;
+
+    ~guarded_scope() noexcept {
+        if (!dismiss_) f_();
+    }
+
+    void dismiss() noexcept { dismiss_ = true; }
+
+   private:
+    F f_;
+    bool dismiss_;
+};
+
+/**
+ * @brief Creates a guarded scope which calls @p f on scope exit unless it is dismissed.
+ *
+ * @param f The function to call on scope exit.
+ *
+ * @return The guarded scope.
+ */
+template <typename F>
+guarded_scope<typename std::decay<F>::type> make_guarded_scope(F &&f) noexcept {
+    return guarded_scope<typename std::decay<F>::type>(typename std::decay<F>::type(std::forward<F>(f)));
+}
+
+}  // namespace detail
+}  // namespace bjg
+
+#endif
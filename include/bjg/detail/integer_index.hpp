@@ -0,0 +1,430 @@
+#ifndef BJG_DETAIL_INTEGER_INDEX_HPP
+#define BJG_DETAIL_INTEGER_INDEX_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "bjg/detail/allocator_utils.hpp"
+#include "bjg/detail/errors.hpp"
+#include "bjg/detail/prefetch.hpp"
+
+namespace bjg {
+namespace detail {
+
+/**
+ * @brief Index of integer keys, which stores each key inline next to its slot, so finding a key compares integers in the
+ * buckets and never reads the items. It is a linear probing table whose empty buckets hold the no_slot sentinel. The keys
+ * are placed by a multiply-shift hash of their own, so the hashes given by the caller are ignored and the caller need not
+ * compute them, and erasing a key shifts the following keys of its run back instead of leaving a tombstone.
+ *
+ * Each bucket is tagged with the epoch in which its key was inserted, and only the buckets of the current epoch hold keys,
+ * so clearing the index starts a new epoch instead of writing over all its buckets.
+ *
+ * It has the interface of flat_index, so lru_cache_base can use either of them.
+ *
+ * @tparam Key The integral type of the keys.
+ * @tparam Slot The unsigned integer type of the slots. Its maximum value is reserved for no_slot.
+ * @tparam Allocator An allocator rebound to allocate the buckets. It must use raw pointers.
+ */
+template <class Key, class Slot, class Allocator = std::allocator<Slot>>
+class integer_index {
+    static_assert(std::is_integral<Key>::value, "The keys must be integers");
+
+   public:
+    using size_type = std::size_t;
+    using allocator_type = Allocator;
+
+    /**
+     * @brief Bucket returned when no bucket is found.
+     */
+    static constexpr size_type npos = static_cast<size_type>(-1);
+
+    /**
+     * @brief Slot returned when a key does not exist.
+     */
+    static constexpr Slot no_slot = static_cast<Slot>(-1);
+
+    /**
+     * @brief Whether the index places the keys by the hashes it is given. This one does not, so the caller need not hash them.
+     */
+    static constexpr bool hashes_keys = false;
+
+    /**
+     * @brief Outcome of a lookup which prepares the insertion of the key if it does not exist.
+     */
+    struct insert_position {
+        /**
+         * @brief The slot of the key or no_slot if the key does not exist.
+         */
+        Slot slot;
+
+        /**
+         * @brief The bucket where the key can be inserted if it does not exist, or npos if the buckets must grow first.
+         */
+        size_type bucket;
+    };
+
+    explicit integer_index(const Allocator &alloc = Allocator()) noexcept : alloc_(alloc) {}
+
+    integer_index(const integer_index &other)
+        : integer_index(other, traits::select_on_container_copy_construction(other.alloc_)) {}
+
+    integer_index(const integer_index &other, const Allocator &alloc) : alloc_(alloc) { copy_from(other); }
+
+    integer_index(integer_index &&other) noexcept : alloc_(std::move(other.alloc_)) { swap_buckets(other); }
+
+    integer_index(integer_index &&other, const Allocator &alloc) : alloc_(alloc) {
+        if (alloc_ == other.alloc_) {
+            swap_buckets(other);
+        } else {
+            copy_from(other);
+        }
+    }
+
+    integer_index &operator=(const integer_index &other) {
+        if (this != &other) {
+            integer_index copy{other, traits::propagate_on_container_copy_assignment::value ? other.alloc_ : alloc_};
+            swap_buckets(copy);
+            swap_allocators(alloc_, copy.alloc_, typename traits::propagate_on_container_copy_assignment{});
+        }
+        return *this;
+    }
+
+    integer_index &operator=(integer_index &&other) noexcept(traits::propagate_on_container_move_assignment::value) {
+        if (this != &other) {
+            integer_index moved{std::move(other),
+                                traits::propagate_on_container_move_assignment::value ? other.alloc_ : alloc_};
+            swap_buckets(moved);
+            swap_allocators(alloc_, moved.alloc_, typename traits::propagate_on_container_move_assignment{});
+        }
+        return *this;
+    }
+
+    ~integer_index() { deallocate(alloc_, buckets_, bucket_count_); }
+
+    /**
+     * @brief Swaps the content of two indices. The allocators are swapped only if they propagate on swap, otherwise they must
+     * be equal.
+     */
+    void swap(integer_index &other) noexcept {
+        swap_buckets(other);
+        swap_allocators(alloc_, other.alloc_, typename traits::propagate_on_container_swap{});
+    }
+
+    allocator_type get_allocator() const noexcept { return alloc_; }
+
+    bool empty() const noexcept { return size_ == 0; }
+
+    size_type size() const noexcept { return size_; }
+
+    /**
+     * @brief Finds the slot of a key.
+     *
+     * @param key The key to look for.
+     *
+     * @return The slot of the key or no_slot if the key does not exist.
+     */
+    template <class Matches>
+    Slot find(const Key key, const std::size_t /*hash*/, Matches /*matches*/) const noexcept {
+        if (size_ == 0) return no_slot;
+
+        auto bucket = home(key);
+        while (occupied(bucket) && buckets_[bucket].key != key) bucket = next(bucket);
+        return occupied(bucket) ? buckets_[bucket].slot : no_slot;
+    }
+
+    /**
+     * @brief Prefetches the home bucket of a key.
+     */
+    void prefetch(const Key key, const std::size_t /*hash*/) const noexcept {
+        if (bucket_count_ != 0) detail::prefetch(buckets_ + home(key));
+    }
+
+    /**
+     * @brief Returns the slot held by the home bucket of a key, without probing nor comparing keys, so the caller can
+     * prefetch the item before the key is looked up. It is the slot of the key unless the key was displaced by a collision.
+     */
+    Slot candidate(const Key key, const std::size_t /*hash*/) const noexcept {
+        if (size_ == 0) return no_slot;
+
+        const auto bucket = home(key);
+        return occupied(bucket) ? buckets_[bucket].slot : no_slot;
+    }
+
+    /**
+     * @brief Finds the slot of a key and, in the same probe, the bucket where the key can be inserted.
+     *
+     * @param key The key to look for.
+     *
+     * @return The slot of the key and the bucket where it can be inserted.
+     */
+    template <class Matches>
+    insert_position find_or_prepare_insert(const Key key, const std::size_t /*hash*/, Matches /*matches*/) const noexcept {
+        if (bucket_count_ == 0) return insert_position{no_slot, npos};
+
+        auto bucket = home(key);
+        while (occupied(bucket) && buckets_[bucket].key != key) bucket = next(bucket);
+        return insert_position{occupied(bucket) ? buckets_[bucket].slot : no_slot, bucket};
+    }
+
+    /**
+     * @brief Indexes the slot of a key at the bucket prepared by find_or_prepare_insert. The bucket stays valid as long as
+     * the index is not modified in between.
+     *
+     * @param bucket The bucket returned by find_or_prepare_insert.
+     * @param key The key to index.
+     * @param slot The slot where the key is stored.
+     * @pre The key must not exist in the index.
+     */
+    template <class HashOf>
+    void insert_at(const size_type bucket, const Key key, const std::size_t hash, const Slot slot, HashOf hash_of) {
+        reinsert_at(prepare_insert(bucket, key, hash, hash_of), key, hash, slot, hash_of);
+    }
+
+    /**
+     * @brief Makes room for a key at the bucket prepared by find_or_prepare_insert, doubling the buckets if the key does not
+     * fit. It is the only step of an insertion which can throw, so the caller can take it before storing the key.
+     *
+     * @return The bucket to pass to insert_at, which then does not grow as long as the index is not modified in between.
+     */
+    template <class HashOf>
+    size_type prepare_insert(const size_type bucket, const Key key, const std::size_t /*hash*/, HashOf /*hash_of*/) {
+        if (bucket != npos && fits(size_ + 1, bucket_count_)) return bucket;
+
+        rehash(std::max(min_bucket_count, bucket_count_ * 2));
+        return find_free_bucket(key);
+    }
+
+    /**
+     * @brief Indexes the slot of a key, as insert_at does, right after another key was erased. The index holds fewer keys
+     * than its buckets ever held, so the key always fits.
+     *
+     * @param bucket The bucket returned by find_or_prepare_insert after the erasure.
+     */
+    template <class HashOf>
+    void reinsert_at(const size_type bucket, const Key key, const std::size_t /*hash*/, const Slot slot,
+                     HashOf /*hash_of*/) noexcept {
+        buckets_[bucket] = bucket_type{key, epoch_, slot};
+        ++size_;
+    }
+
+    /**
+     * @brief Removes a key. The keys which follow it in its run and may move closer to their home bucket are shifted back,
+     * so the runs stay as short as if the key had never been inserted.
+     *
+     * @param key The indexed key to remove.
+     */
+    void erase(const Key key, const std::size_t /*hash*/, const Slot /*slot*/) noexcept {
+        auto hole = home(key);
+        while (!occupied(hole) || buckets_[hole].key != key) hole = next(hole);
+
+        for (auto bucket = next(hole); occupied(bucket); bucket = next(bucket)) {
+            // The key can fill the hole unless its home bucket lies between the hole and its bucket
+            const auto mask = bucket_count_ - 1;
+            if (((bucket - home(buckets_[bucket].key)) & mask) >= ((bucket - hole) & mask)) {
+                buckets_[hole] = buckets_[bucket];
+                hole = bucket;
+            }
+        }
+        buckets_[hole].epoch = vacant;
+        --size_;
+    }
+
+    /**
+     * @brief Removes all the keys in constant time, by starting a new epoch: the buckets of the previous epochs are empty. The
+     * buckets are only written when the epoch counter wraps around, after 2^32 clears, or 2^16 for 16 bit slots.
+     */
+    void clear() noexcept {
+        size_ = 0;
+        if (++epoch_ != vacant) return;
+
+        for (size_type bucket = 0; bucket < bucket_count_; ++bucket) buckets_[bucket].epoch = vacant;
+        epoch_ = first_epoch;
+    }
+
+    /**
+     * @brief Allocates enough buckets to hold @p count keys without growing again.
+     *
+     * @param count The number of keys to make room for.
+     */
+    template <class HashOf>
+    void reserve(const size_type count, HashOf hash_of) {
+        if (!try_reserve(count, hash_of)) throw_bad_alloc();
+    }
+
+    /**
+     * @brief Allocates enough buckets to hold @p count keys, as reserve does, but reports an allocator returning nullptr
+     * instead of raising std::bad_alloc.
+     *
+     * @return false if the allocation failed, in which case the index is left unchanged.
+     */
+    template <class HashOf>
+    bool try_reserve(const size_type count, HashOf /*hash_of*/) {
+        auto bucket_count = min_bucket_count;
+        while (!fits(count, bucket_count)) bucket_count *= 2;
+        return bucket_count <= bucket_count_ || try_rehash(bucket_count);
+    }
+
+   private:
+    /**
+     * @brief The epoch tagging the buckets. It is no wider than the slots, so it mostly fits in the padding of the buckets.
+     */
+    using epoch_type = typename std::conditional<(sizeof(Slot) < sizeof(std::uint32_t)), Slot, std::uint32_t>::type;
+
+    /**
+     * @brief Epoch of the buckets which never held a key or whose key was erased. The index epoch never takes this value.
+     */
+    static constexpr epoch_type vacant = 0;
+
+    static constexpr epoch_type first_epoch = 1;
+
+    struct bucket_type {
+        Key key;
+        epoch_type epoch;
+        Slot slot;
+    };
+
+    using traits = std::allocator_traits<Allocator>;
+    using bucket_allocator = typename traits::template rebind_alloc<bucket_type>;
+
+    static constexpr size_type min_bucket_count = 16;
+
+    /**
+     * @brief Checks if @p count keys fit in @p bucket_count buckets, which are at most half full so that the runs stay short.
+     */
+    static constexpr bool fits(const size_type count, const size_type bucket_count) noexcept {
+        return count <= bucket_count / 2;
+    }
+
+    /**
+     * @brief Allocates @p bucket_count empty buckets, or returns nullptr if the allocator does.
+     */
+    static bucket_type *allocate(const Allocator &alloc, const size_type bucket_count) {
+        bucket_allocator buckets_alloc(alloc);
+        auto *const buckets = std::allocator_traits<bucket_allocator>::allocate(buckets_alloc, bucket_count);
+        if (buckets == nullptr) return nullptr;
+
+        for (size_type bucket = 0; bucket < bucket_count; ++bucket) buckets[bucket] = bucket_type{Key(), vacant, no_slot};
+        return buckets;
+    }
+
+    static void deallocate(const Allocator &alloc, bucket_type *buckets, const size_type bucket_count) noexcept {
+        if (bucket_count == 0) return;
+
+        bucket_allocator buckets_alloc(alloc);
+        std::allocator_traits<bucket_allocator>::deallocate(buckets_alloc, buckets, bucket_count);
+    }
+
+    /**
+     * @brief Returns the home bucket of a key: the high bits of the key multiplied by 2^64 divided by the golden ratio.
+     */
+    size_type home(const Key key) const noexcept {
+        const auto product = static_cast<std::uint64_t>(key) * UINT64_C(0x9E3779B97F4A7C15);
+#if SIZE_MAX > UINT32_MAX
+        return product >> shift_;
+#else
+        return static_cast<size_type>(product >> shift_);
+#endif
+    }
+
+    size_type next(const size_type bucket) const noexcept { return (bucket + 1) & (bucket_count_ - 1); }
+
+    /**
+     * @brief Checks if a bucket holds a key, inserted in the current epoch.
+     */
+    bool occupied(const size_type bucket) const noexcept { return buckets_[bucket].epoch == epoch_; }
+
+    size_type find_free_bucket(const Key key) const noexcept {
+        auto bucket = home(key);
+        while (occupied(bucket)) bucket = next(bucket);
+        return bucket;
+    }
+
+    /**
+     * @brief Allocates as many buckets as @p other has and copies them. This index must be empty.
+     */
+    void copy_from(const integer_index &other) {
+        if (other.bucket_count_ == 0) return;
+
+        buckets_ = checked_allocation(allocate(alloc_, other.bucket_count_));
+        std::copy(other.buckets_, other.buckets_ + other.bucket_count_, buckets_);
+        bucket_count_ = other.bucket_count_;
+        shift_ = other.shift_;
+        epoch_ = other.epoch_;
+        size_ = other.size_;
+    }
+
+    /**
+     * @brief Moves the keys into @p bucket_count new buckets.
+     */
+    void rehash(const size_type bucket_count) {
+        if (!try_rehash(bucket_count)) throw_bad_alloc();
+    }
+
+    /**
+     * @brief Moves the keys into @p bucket_count new buckets, as rehash does.
+     *
+     * @return false if the allocator returned nullptr, in which case the index is left unchanged.
+     */
+    bool try_rehash(const size_type bucket_count) {
+        auto *const buckets = allocate(alloc_, bucket_count);
+        if (buckets == nullptr) return false;
+
+        integer_index rebuilt{alloc_};
+        rebuilt.buckets_ = buckets;
+        rebuilt.bucket_count_ = bucket_count;
+        rebuilt.shift_ = 64;
+        for (auto count = bucket_count; count > 1; count /= 2) --rebuilt.shift_;
+
+        for (size_type bucket = 0; bucket < bucket_count_; ++bucket) {
+            if (!occupied(bucket)) continue;
+
+            rebuilt.reinsert_at(rebuilt.find_free_bucket(buckets_[bucket].key), buckets_[bucket].key, 0,
+                                buckets_[bucket].slot, nullptr);
+        }
+        swap_buckets(rebuilt);
+        return true;
+    }
+
+    void swap_buckets(integer_index &other) noexcept {
+        std::swap(buckets_, other.buckets_);
+        std::swap(bucket_count_, other.bucket_count_);
+        std::swap(shift_, other.shift_);
+        std::swap(epoch_, other.epoch_);
+        std::swap(size_, other.size_);
+    }
+
+    Allocator alloc_;
+    bucket_type *buckets_{nullptr};
+    size_type bucket_count_{0};
+    unsigned shift_{64};
+    epoch_type epoch_{first_epoch};
+    size_type size_{0};
+};
+
+template <class Key, class Slot, class Allocator>
+constexpr typename integer_index<Key, Slot, Allocator>::size_type integer_index<Key, Slot, Allocator>::npos;
+
+template <class Key, class Slot, class Allocator>
+constexpr Slot integer_index<Key, Slot, Allocator>::no_slot;
+
+template <class Key, class Slot, class Allocator>
+constexpr bool integer_index<Key, Slot, Allocator>::hashes_keys;
+
+template <class Key, class Slot, class Allocator>
+constexpr typename integer_index<Key, Slot, Allocator>::epoch_type integer_index<Key, Slot, Allocator>::vacant;
+
+template <class Key, class Slot, class Allocator>
+constexpr typename integer_index<Key, Slot, Allocator>::epoch_type integer_index<Key, Slot, Allocator>::first_epoch;
+
+template <class Key, class Slot, class Allocator>
+constexpr typename integer_index<Key, Slot, Allocator>::size_type integer_index<Key, Slot, Allocator>::min_bucket_count;
+
+}  // namespace detail
+}  // namespace bjg
+
+#endif
@@ -0,0 +1,1091 @@
+#ifndef BJG_DETAIL_LRU_CACHE_BASE_HPP
+#define BJG_DETAIL_LRU_CACHE_BASE_HPP
+
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "bjg/detail/errors.hpp"
+#include "bjg/detail/flat_index.hpp"
+#include "bjg/detail/guarded_scope.hpp"
+#include "bjg/detail/type_traits.hpp"
+
+namespace bjg {
+namespace detail {
+
+/**
+ * @brief Operations shared by the lru caches, whatever their storage. The items are kept in a recency slab and their slab
+ * indices in a flat keys index. Each key is hashed once when it is inserted; the hash is stored with the item and reused for
+ * evicting and reindexing it. The keys index either holds the slab indices of the items only, so each key is stored once,
+ * in its item, or stores small keys inline next to their slab indices, so they are compared without reading the items.
+ *
+ * When both @p Hash and @p KeyEqual are transparent, get, try_get, peek, contains and erase also accept any key type they
+ * support, e.g. a string view for string keys, so lookups do not build a temporary Key.
+ *
+ * @tparam Key The key which uniquely identifies an item from the lru cache.
+ * @tparam Value The value associated to the @p Key.
+ * @tparam Hash The hash function of the keys.
+ * @tparam KeyEqual The equality function of the keys.
+ * @tparam Items The recency slab of the items, which can hold one item more than the capacity. It gives access to the key and
+ * the value of an item by its index, whether it stores them together or apart. The handles of the items are only available
+ * when its nodes have generations.
+ * @tparam Keys The flat index of the items' slab indices.
+ */
+template <class Key, class Value, class Hash, class KeyEqual, class Items, class Keys>
+class lru_cache_base {
+   public:
+    using item_type = std::pair<const Key, Value>;
+    using hasher = Hash;
+    using key_equal = KeyEqual;
+    using items_list = Items;
+    using items_list_index = typename items_list::size_type;
+    using keys_type = Keys;
+
+    /**
+     * @brief Stable reference to an item, returned by put and find. It gives access to the item again without hashing nor
+     * comparing its key. A handle becomes stale when its item is evicted, erased, recycled for another key or cleared, and
+     * when the lru cache is assigned; the accessors taking a handle detect it through the generation of the item's node and
+     * the epoch of the lru cache. A copy or a move of an lru cache accepts the handles of its source.
+     *
+     * The generations take 4 bytes per item, so only the lru caches created with handles enabled have them. Without them,
+     * put returns nothing, and find and the accessors taking a handle do not compile.
+     *
+     * A default handle refers to no item.
+     */
+    struct handle {
+        items_list_index index{keys_type::no_slot};
+        typename items_list::generation_type generation{0};
+        typename items_list::generation_type epoch{0};
+
+        /**
+         * @brief Checks if the handle was returned for an item, which may since have been removed.
+         */
+        explicit operator bool() const noexcept { return index != keys_type::no_slot; }
+    };
+
+    /**
+     * @brief The result of put: the handle of the item when the handles are enabled, nothing otherwise.
+     */
+    using put_result = typename std::conditional<items_list::has_generations, handle, void>::type;
+
+    /**
+     * @brief Checks if the lru cache has no items.
+     *
+     * @return true if the lru cache is empty, false otherwise.
+     */
+    bool empty() const noexcept { return keys_.empty(); }
+
+    /**
+     * @brief Returns the hash function of the keys. The overloads taking a hash expect the hashes it returns. Integer keys
+     * stored inline in the keys index are never hashed, so these overloads ignore their hash, as a lookup without it does.
+     */
+    hasher hash_function() const { return hash_; }
+
+    /**
+     * @brief Returns the equality function of the keys.
+     */
+    key_equal key_eq() const { return equal_; }
+
+    /**
+     * @brief Returns the number of items in the lru cache.
+     *
+     * @return The number of items.
+     */
+    std::size_t size() const noexcept { return keys_.size(); }
+
+    /**
+     * @brief Remove all items from the lru cache. The items are not destroyed right away: they join the graveyard, whose
+     * items beyond its capacity are destroyed one per later insertion, and the remaining ones are destroyed by reclaim or
+     * with the lru cache. Until then, the cleared items keep holding their memory, e.g. the buffers of their strings.
+     *
+     * Only the keys index is reset. An index of integer keys starts a new epoch in constant time, but a flat index writes
+     * all its control bytes, which takes a time linear in its number of buckets, not in the number of items.
+     */
+    void clear() noexcept {
+        keys_.clear();
+        items_.clear();
+    }
+
+    /**
+     * @brief Keeps up to @p count evicted items in a graveyard instead of destroying them, so the destructors of their keys
+     * and values run in reclaim rather than in put. The storage of the graveyard is allocated up front. While the graveyard
+     * is full, evicted items are destroyed right away, so its size stays bounded when reclaim is not called often enough.
+     * A full lru cache does not reuse its least recent item while the graveyard capacity is not zero.
+     *
+     * A static lru cache has no storage beyond its capacity, so each insertion into a full static lru cache still destroys
+     * an item.
+     *
+     * @param count The capacity of the graveyard, 0 to destroy the evicted items right away.
+     *
+     * @throws std::length_error if the items of the lru cache and of the graveyard cannot be linked by items_list_index.
+     */
+    void set_graveyard_capacity(const std::size_t count) {
+        if (count > static_cast<std::size_t>(-1) - capacity_ - 1) {
+            throw_length_error("Graveyard capacity is too large");
+        }
+
+        items_.extend(capacity_ + 1 + count);
+        graveyard_capacity_ = count;
+        if (items_.retired_size() > count) items_.release_retired(items_.retired_size() - count);
+    }
+
+    /**
+     * @brief Returns the number of evicted or cleared items which are not destroyed yet.
+     */
+    std::size_t graveyard_size() const noexcept { return items_.retired_size(); }
+
+    /**
+     * @brief Destroys up to @p budget items of the graveyard, the earliest evicted first.
+     *
+     * @param budget The maximum number of items to destroy.
+     *
+     * @return The number of destroyed items.
+     */
+    std::size_t reclaim(const std::size_t budget) noexcept { return items_.release_retired(budget); }
+
+    /**
+     * @brief Adds an item to the lru cache or update the existing item's value and mark it as the most recent one if the key
+     * already exists.
+     *
+     * When the lru cache is full, the new item reuses the node of the least recent item: its key and value are assigned to
+     * those of the evicted item if these assignments cannot throw, as for integers, otherwise they are copied first and the
+     * copies are moved into the evicted item. Keys or values which cannot be moved without throwing are constructed in a new
+     * item before the least recent item is evicted.
+     *
+     * The exception guarantee is strong: if copying the key or the value throws, the lru cache is unchanged.
+     *
+     * @param item The item to insert.
+     *
+     * @return The handle of the item, if the handles are enabled.
+     */
+    put_result put(const item_type &item) {
+        put_item(item);
+        return front_handle();
+    }
+
+    /**
+     * @brief Adds an item to the lru cache or update the existing item's value and mark it as the most recent one if the key
+     * already exists. The value is moved instead of copied, so move-only values can be stored. A full lru cache reuses its
+     * least recent item as with the copying overload, and the exception guarantee is strong too.
+     *
+     * @param item The item to insert.
+     *
+     * @return The handle of the item, if the handles are enabled.
+     */
+    put_result put(item_type &&item) {
+        put_item(std::move(item));
+        return front_handle();
+    }
+
+    /**
+     * @brief Overload of put taking the hash of the item's key, so a hash the caller already computed is not computed again.
+     *
+     * @param item The item to insert.
+     * @param hash The hash of the item's key, as returned by hash_function(). A different hash is undefined behavior, unless
+     * the keys are integers stored inline in the keys index, whose hashes are ignored.
+     */
+    put_result put(const item_type &item, const std::size_t hash) {
+        put_item(item, given_hash(item.first, hash));
+        return front_handle();
+    }
+
+    /**
+     * @brief Overload of put moving the item and taking the hash of its key.
+     */
+    put_result put(item_type &&item, const std::size_t hash) {
+        put_item(std::move(item), given_hash(item.first, hash));
+        return front_handle();
+    }
+
+    /**
+     * @brief Adds an item whose value is constructed in place from @p args, or replaces the value of the existing item with
+     * a value constructed from @p args, and marks the item as the most recent one.
+     *
+     * @param key The key of the item.
+     * @param args The arguments forwarded to the value's constructor.
+     *
+     * @return true if a new item was inserted, false if an existing item was updated.
+     */
+    template <class... Args>
+    bool emplace(const Key &key, Args &&...args) {
+        return emplace_item(false, key, std::forward<Args>(args)...);
+    }
+
+    /**
+     * @brief Overload of emplace moving the key into a new item.
+     */
+    template <class... Args>
+    bool emplace(Key &&key, Args &&...args) {
+        return emplace_item(false, std::move(key), std::forward<Args>(args)...);
+    }
+
+    /**
+     * @brief Adds an item whose value is constructed in place from @p args if the key does not exist. Otherwise, the existing
+     * item keeps its value, the arguments are left untouched and the item is only marked as the most recent one.
+     *
+     * @param key The key of the item.
+     * @param args The arguments forwarded to the value's constructor.
+     *
+     * @return true if a new item was inserted, false if the key already existed.
+     */
+    template <class... Args>
+    bool try_emplace(const Key &key, Args &&...args) {
+        return emplace_item(true, key, std::forward<Args>(args)...);
+    }
+
+    /**
+     * @brief Overload of try_emplace moving the key into a new item.
+     */
+    template <class... Args>
+    bool try_emplace(Key &&key, Args &&...args) {
+        return emplace_item(true, std::move(key), std::forward<Args>(args)...);
+    }
+
+    /**
+     * @brief Calls a function on the value of an item, if it exists, and marks the item as the most recent one. The value is
+     * modified in place, without building a new value. If the function throws, the item is not promoted and keeps the value
+     * as the function left it.
+     *
+     * @param key The key of the item.
+     * @param fn The function called with a reference to the stored value.
+     *
+     * @return true if the item exists, false otherwise.
+     */
+    template <class F>
+    bool update(const Key &key, F &&fn) {
+        return update_item(find_item(key, hash_key(key)), std::forward<F>(fn));
+    }
+
+    /**
+     * @brief Transparent overload of update, looking up a key of any type supported by Hash and KeyEqual.
+     */
+    template <class K, class F, class = enable_if_transparent<Hash, KeyEqual, K>>
+    bool update(const K &key, F &&fn) {
+        return update_item(find_item(key, hash_key(key)), std::forward<F>(fn));
+    }
+
+    /**
+     * @brief Calls @p update_fn on the value of an item if it exists, otherwise adds an item whose value is returned by
+     * @p make_fn. Either way, the item is marked as the most recent one, with a single lookup of the key. If @p make_fn
+     * throws, the lru cache is unchanged; if @p update_fn throws, as with update.
+     *
+     * @param key The key of the item.
+     * @param make_fn The function returning the value of a new item.
+     * @param update_fn The function called with a reference to the stored value of an existing item.
+     *
+     * @return true if a new item was inserted, false if an existing item was updated.
+     */
+    template <class Make, class Update>
+    bool upsert(const Key &key, Make &&make_fn, Update &&update_fn) {
+        return upsert_item(key, std::forward<Make>(make_fn), std::forward<Update>(update_fn));
+    }
+
+    /**
+     * @brief Overload of upsert moving the key into a new item.
+     */
+    template <class Make, class Update>
+    bool upsert(Key &&key, Make &&make_fn, Update &&update_fn) {
+        return upsert_item(std::move(key), std::forward<Make>(make_fn), std::forward<Update>(update_fn));
+    }
+
+    /**
+     * @brief Returns the value of an existing item and mark the item as the most recent one.
+     *
+     * @param key The key of the existing item.
+     *
+     * @return The value associated to the given key.
+     * @throws std::out_of_range if the key does not exist.
+     */
+    const Value &get(const Key &key) { return checked_value(try_get(key)); }
+
+    /**
+     * @brief Overload of get taking the hash of the key, as returned by hash_function(). A different hash is undefined
+     * behavior.
+     */
+    const Value &get(const Key &key, const std::size_t hash) { return checked_value(try_get(key, hash)); }
+
+    /**
+     * @brief Transparent overload of get, looking up a key of any type supported by Hash and KeyEqual.
+     */
+    template <class K, class = enable_if_transparent<Hash, KeyEqual, K>>
+    const Value &get(const K &key) {
+        return checked_value(try_get(key));
+    }
+
+    /**
+     * @brief Returns the value of an item, if it exists, and marks the item as the most recent one. Unlike get, a missing key
+     * is not an error.
+     *
+     * @param key The key of the item.
+     *
+     * @return A pointer to the value associated to the given key or nullptr if the key does not exist. The pointer is
+     * invalidated by the next insertion.
+     */
+    const Value *try_get(const Key &key) { return promote(find_item(key, hash_key(key))); }
+
+    /**
+     * @brief Overload of try_get taking the hash of the key, as returned by hash_function(). A different hash is undefined
+     * behavior.
+     */
+    const Value *try_get(const Key &key, const std::size_t hash) { return promote(find_item(key, given_hash(key, hash))); }
+
+    /**
+     * @brief Transparent overload of try_get, looking up a key of any type supported by Hash and KeyEqual.
+     */
+    template <class K, class = enable_if_transparent<Hash, KeyEqual, K>>
+    const Value *try_get(const K &key) {
+        return promote(find_item(key, hash_key(key)));
+    }
+
+    /**
+     * @brief Returns the value of an item, if it exists, without marking the item as the most recent one.
+     *
+     * @param key The key of the item.
+     *
+     * @return A pointer to the value associated to the given key or nullptr if the key does not exist. The pointer is
+     * invalidated by the next insertion.
+     */
+    const Value *peek(const Key &key) const { return value_at(find_item(key, hash_key(key))); }
+
+    /**
+     * @brief Overload of peek taking the hash of the key, as returned by hash_function(). A different hash is undefined
+     * behavior.
+     */
+    const Value *peek(const Key &key, const std::size_t hash) const { return value_at(find_item(key, given_hash(key, hash))); }
+
+    /**
+     * @brief Transparent overload of peek, looking up a key of any type supported by Hash and KeyEqual.
+     */
+    template <class K, class = enable_if_transparent<Hash, KeyEqual, K>>
+    const Value *peek(const K &key) const {
+        return value_at(find_item(key, hash_key(key)));
+    }
+
+    /**
+     * @brief Checks if the lru cache contains an item with the given key.
+     *
+     * @param key The key to check.
+     *
+     * @return true if the key exists, false otherwise.
+     */
+    bool contains(const Key &key) const { return find_item(key, hash_key(key)) != keys_type::no_slot; }
+
+    /**
+     * @brief Overload of contains taking the hash of the key, as returned by hash_function(). A different hash is undefined
+     * behavior.
+     */
+    bool contains(const Key &key, const std::size_t hash) const {
+        return find_item(key, given_hash(key, hash)) != keys_type::no_slot;
+    }
+
+    /**
+     * @brief Transparent overload of contains, looking up a key of any type supported by Hash and KeyEqual.
+     */
+    template <class K, class = enable_if_transparent<Hash, KeyEqual, K>>
+    bool contains(const K &key) const {
+        return find_item(key, hash_key(key)) != keys_type::no_slot;
+    }
+
+    /**
+     * @brief Removes the item with the given key, if it exists.
+     *
+     * @param key The key of the item to remove.
+     *
+     * @return true if an item was removed, false if the key does not exist.
+     */
+    bool erase(const Key &key) { return erase_item(find_item(key, hash_key(key))); }
+
+    /**
+     * @brief Overload of erase taking the hash of the key, as returned by hash_function(). A different hash is undefined
+     * behavior.
+     */
+    bool erase(const Key &key, const std::size_t hash) { return erase_item(find_item(key, given_hash(key, hash))); }
+
+    /**
+     * @brief Transparent overload of erase, looking up a key of any type supported by Hash and KeyEqual.
+     */
+    template <class K, class = enable_if_transparent<Hash, KeyEqual, K>>
+    bool erase(const K &key) {
+        return erase_item(find_item(key, hash_key(key)));
+    }
+
+    /**
+     * @brief Returns the handle of an item, if it exists, without marking the item as the most recent one.
+     *
+     * @param key The key of the item.
+     *
+     * @return The handle of the item or a default handle if the key does not exist.
+     */
+    handle find(const Key &key) const { return make_handle(find_item(key, hash_key(key))); }
+
+    /**
+     * @brief Overload of find taking the hash of the key, as returned by hash_function(). A different hash is undefined
+     * behavior.
+     */
+    handle find(const Key &key, const std::size_t hash) const { return make_handle(find_item(key, given_hash(key, hash))); }
+
+    /**
+     * @brief Transparent overload of find, looking up a key of any type supported by Hash and KeyEqual.
+     */
+    template <class K, class = enable_if_transparent<Hash, KeyEqual, K>>
+    handle find(const K &key) const {
+        return make_handle(find_item(key, hash_key(key)));
+    }
+
+    /**
+     * @brief Overload of get reaching the item through its handle, without hashing its key.
+     *
+     * @throws std::out_of_range if the handle is stale.
+     */
+    const Value &get(const handle &item) { return checked_value(try_get(item)); }
+
+    /**
+     * @brief Overload of try_get reaching the item through its handle, without hashing its key.
+     *
+     * @return A pointer to the value of the item or nullptr if the handle is stale.
+     */
+    const Value *try_get(const handle &item) noexcept { return promote(index_of(item)); }
+
+    /**
+     * @brief Overload of peek reaching the item through its handle, without hashing its key.
+     *
+     * @return A pointer to the value of the item or nullptr if the handle is stale.
+     */
+    const Value *peek(const handle &item) const noexcept { return value_at(index_of(item)); }
+
+    /**
+     * @brief Checks if the item of a handle is still in the lru cache.
+     */
+    bool contains(const handle &item) const noexcept { return index_of(item) != keys_type::no_slot; }
+
+    /**
+     * @brief Overload of update reaching the item through its handle, without hashing its key.
+     *
+     * @return true if the handle is current, false if it is stale.
+     */
+    template <class F>
+    bool update(const handle &item, F &&fn) {
+        return update_item(index_of(item), std::forward<F>(fn));
+    }
+
+    /**
+     * @brief Marks the item of a handle as the most recent one.
+     *
+     * @return true if the handle is current, false if it is stale.
+     */
+    bool touch(const handle &item) noexcept { return promote(index_of(item)) != nullptr; }
+
+    /**
+     * @brief Looks up a batch of keys, as try_get does for each of them. The keys are processed in groups: all the keys of
+     * a group are hashed and their index buckets and items are prefetched before any of them is compared, so the cache
+     * misses of the group overlap. The found items are then marked as the most recent ones together, in the order of their
+     * keys. If hashing or comparing a key throws, the groups before it are looked up and the rest are not.
+     *
+     * @param first The first key. The keys are read twice, so the iterators must be forward iterators. With a transparent
+     * Hash and KeyEqual, the keys may have any type they support.
+     * @param last The end of the keys.
+     * @param out Receives, for each key, a pointer to its value or nullptr if the key does not exist. The pointers are
+     * invalidated by the next insertion.
+     *
+     * @return The output iterator past the last pointer written.
+     */
+    template <class ForwardIt, class OutputIt>
+    OutputIt multi_get(ForwardIt first, const ForwardIt last, OutputIt out) {
+        std::size_t hashes[batch_size];
+        items_list_index found[batch_size];
+        while (first != last) {
+            std::size_t count = 0;
+            const auto next = prefetch_batch(first, last, key_itself{}, hashes, count);
+            for (std::size_t i = 0; i < count; ++i, ++first) found[i] = find_item(*first, hashes[i]);
+            for (std::size_t i = 0; i < count; ++i) *out++ = promote(found[i]);
+            first = next;
+        }
+        return out;
+    }
+
+    /**
+     * @brief Puts a batch of items, as put does for each of them, in order. The items are processed in groups whose keys are
+     * hashed and whose index buckets and items are prefetched before any of them is inserted. If an item throws, the items
+     * before it are put and the lru cache keeps the guarantee of put for the throwing item.
+     *
+     * @param first The first item. The items are read twice, so the iterators must be forward iterators. Move iterators move
+     * the items into the lru cache.
+     * @param last The end of the items.
+     */
+    template <class ForwardIt>
+    void multi_put(ForwardIt first, const ForwardIt last) {
+        std::size_t hashes[batch_size];
+        while (first != last) {
+            std::size_t count = 0;
+            const auto next = prefetch_batch(first, last, item_key{}, hashes, count);
+            for (std::size_t i = 0; i < count; ++i, ++first) put_item(*first, hashes[i]);
+            first = next;
+        }
+    }
+
+   protected:
+    /**
+     * @brief Creates an empty lru cache.
+     *
+     * @param capacity The maximum capacity of the cache. Once this limit is reached, least recent items are evicted.
+     * @param hash The hash function of the keys.
+     * @param equal The equality function of the keys.
+     * @param items The empty slab of the items, which must hold up to capacity + 1 items.
+     * @param keys The empty index of the keys.
+     *
+     * @throws std::length_error if the capacity is zero.
+     */
+    lru_cache_base(const std::size_t capacity, const Hash &hash, const KeyEqual &equal, Items &&items, Keys &&keys)
+        : capacity_{nonzero_capacity(capacity)},
+          hash_(hash),
+          equal_(equal),
+          items_(std::move(items)),
+          keys_(std::move(keys)) {}
+
+    /**
+     * @brief Creates an empty lru cache whose slab and keys index are default constructed in place, as the inline ones of
+     * a static lru cache, which are too large to be built apart and moved.
+     *
+     * @throws std::length_error if the capacity is zero.
+     */
+    lru_cache_base(const std::size_t capacity, const Hash &hash, const KeyEqual &equal)
+        : capacity_{nonzero_capacity(capacity)}, hash_(hash), equal_(equal), items_(), keys_() {}
+
+    lru_cache_base(const lru_cache_base &) = default;
+    lru_cache_base(lru_cache_base &&) = default;
+
+    /**
+     * @brief Copies the items of another lru cache. If the copy fails, the lru cache is left empty.
+     */
+    lru_cache_base &operator=(const lru_cache_base &other) {
+        if (this != &other) assign([this, &other]() { assign_members(other); });
+        return *this;
+    }
+
+    /**
+     * @brief Moves the items of another lru cache. If the move fails, the lru cache is left empty.
+     */
+    lru_cache_base &operator=(lru_cache_base &&other) noexcept(std::is_nothrow_move_assignable<Items>::value &&
+                                                                std::is_nothrow_move_assignable<Keys>::value) {
+        if (this != &other) assign([this, &other]() { assign_members(std::move(other)); });
+        return *this;
+    }
+
+    ~lru_cache_base() = default;
+
+    /**
+     * @brief The number of keys hashed and prefetched together by multi_get and multi_put. It is small enough for the
+     * prefetched lines to stay in the L1 cache until they are used.
+     */
+    static constexpr std::size_t batch_size = 16;
+
+    /**
+     * @brief Returns the hash stored with the item at a given index, or derives it from the item's key, as hash_key does,
+     * when the slab stores no hashes.
+     */
+    struct stored_hash {
+        const items_list *items;
+
+        std::size_t operator()(const items_list_index index) const noexcept {
+            return hash_of(index, std::integral_constant<bool, items_list::has_hashes>{});
+        }
+
+       private:
+        std::size_t hash_of(const items_list_index index, std::true_type /*stored*/) const noexcept {
+            return items->hash(index);
+        }
+
+        std::size_t hash_of(const items_list_index index, std::false_type /*stored*/) const noexcept {
+            return static_cast<std::size_t>(items->key(index));
+        }
+    };
+
+   private:
+    static_assert(items_list::has_hashes || !keys_type::hashes_keys,
+                  "The slab must store the hashes of the items when the keys index places them by their hashes");
+
+    /**
+     * @brief Checks if the item at a given index has the searched key. The stored hashes are compared before the keys, so
+     * keys are only compared when their full hashes match.
+     */
+    template <class K>
+    struct item_matches {
+        const lru_cache_base *cache;
+        const K &key;
+        std::size_t hash;
+
+        bool operator()(const items_list_index index) const {
+            return cache->items_.hash(index) == hash && cache->equal_(cache->items_.key(index), key);
+        }
+    };
+
+    /**
+     * @brief Returns the capacity, raising std::length_error if it is zero.
+     */
+    static std::size_t nonzero_capacity(const std::size_t capacity) {
+        if (capacity == 0) {
+            throw_length_error("Cache capacity must be greater than zero");
+        }
+
+        return capacity;
+    }
+
+    /**
+     * @brief Calls a function which assigns all the members and empties the lru cache if the call fails, as the items and
+     * the keys index may then be out of sync.
+     */
+    template <class F>
+    void assign(F f) {
+        guarded_call(f, [this]() { clear(); });
+    }
+
+    template <class Other>
+    void assign_members(Other &&other) {
+        const auto epoch = items_.epoch();
+        capacity_ = other.capacity_;
+        graveyard_capacity_ = other.graveyard_capacity_;
+        hash_ = std::forward<Other>(other).hash_;
+        equal_ = std::forward<Other>(other).equal_;
+        items_ = std::forward<Other>(other).items_;
+        keys_ = std::forward<Other>(other).keys_;
+        items_.advance_epoch(epoch);
+    }
+
+    /**
+     * @brief Calls a function and reverts its behavior if the call fails.
+     *
+     * @param f The function to call.
+     * @param r The function which reverts f's behavior.
+     */
+    template <typename F, typename R>
+    void guarded_call(F &&f, R &&r) {
+        auto guard = make_guarded_scope(std::forward<R>(r));
+        f();
+        guard.dismiss();
+    }
+
+    /**
+     * @brief Returns the mixed hash of a key, as used by the keys index. It is truncated to the width of the hashes stored
+     * in the slab, so the index always sees the hash of a key as stored. When the keys index does not place the keys by
+     * their hashes, hash_ is not called and the key itself stands for its hash.
+     *
+     * @param key The key to hash.
+     *
+     * @return The mixed hash of the key.
+     */
+    template <class K>
+    std::size_t hash_key(const K &key) const {
+        return hash_key(key, std::integral_constant<bool, keys_type::hashes_keys>{});
+    }
+
+    template <class K>
+    std::size_t hash_key(const K &key, std::true_type /*hashed*/) const {
+        return mixed_hash(hash_(key));
+    }
+
+    template <class K>
+    static std::size_t hash_key(const K &key, std::false_type /*hashed*/) noexcept {
+        return static_cast<std::size_t>(key);
+    }
+
+    /**
+     * @brief Returns the hash of a key, as hash_key does, from the hash of the key given by the caller. When the keys index
+     * does not place the keys by their hashes, the given hash is ignored, as hash_ is by hash_key.
+     */
+    template <class K>
+    std::size_t given_hash(const K &key, const std::size_t hash) const noexcept {
+        return given_hash(key, hash, std::integral_constant<bool, keys_type::hashes_keys>{});
+    }
+
+    template <class K>
+    static std::size_t given_hash(const K & /*key*/, const std::size_t hash, std::true_type /*hashed*/) noexcept {
+        return mixed_hash(hash);
+    }
+
+    template <class K>
+    static std::size_t given_hash(const K &key, const std::size_t /*hash*/, std::false_type /*hashed*/) noexcept {
+        return hash_key(key, std::false_type{});
+    }
+
+    /**
+     * @brief Mixes and truncates a hash computed by hash_, as hash_key does.
+     */
+    static std::size_t mixed_hash(const std::size_t hash) noexcept {
+        return static_cast<typename items_list::hash_type>(mix_hash(hash));
+    }
+
+    /**
+     * @brief Finds the item of a key.
+     *
+     * @param key The key to look for.
+     * @param hash The mixed hash of the key.
+     *
+     * @return The index of the item or keys_type::no_slot if the key does not exist.
+     */
+    template <class K>
+    items_list_index find_item(const K &key, const std::size_t hash) const {
+        return keys_.find(key, hash, item_matches<K>{this, key, hash});
+    }
+
+    /**
+     * @brief Returns the handle of the item at @p index, or a default handle if @p index is keys_type::no_slot.
+     */
+    handle make_handle(const items_list_index index) const noexcept {
+        static_assert(items_list::has_generations, "Handles need an lru cache created with handles enabled");
+
+        handle result;
+        if (index == keys_type::no_slot) return result;
+
+        result.index = index;
+        result.generation = items_.generation(index);
+        result.epoch = items_.epoch();
+        return result;
+    }
+
+    /**
+     * @brief Returns the handle of the most recent item, which put has just inserted or updated, if the handles are enabled.
+     */
+    put_result front_handle() const noexcept {
+        return front_handle(std::integral_constant<bool, items_list::has_generations>{});
+    }
+
+    handle front_handle(std::true_type) const noexcept { return make_handle(items_.head()); }
+
+    void front_handle(std::false_type) const noexcept {}
+
+    /**
+     * @brief Returns the index of the item of a handle, or keys_type::no_slot if the handle is stale.
+     */
+    items_list_index index_of(const handle &item) const noexcept {
+        static_assert(items_list::has_generations, "Handles need an lru cache created with handles enabled");
+
+        return items_.is_current(item.index, item.generation, item.epoch) ? item.index : keys_type::no_slot;
+    }
+
+    /**
+     * @brief Returns a key given as is, for prefetch_batch.
+     */
+    struct key_itself {
+        template <class K>
+        const K &operator()(const K &key) const noexcept {
+            return key;
+        }
+    };
+
+    /**
+     * @brief Returns the key of an item, for prefetch_batch.
+     */
+    struct item_key {
+        template <class Item>
+        auto operator()(const Item &item) const noexcept -> decltype((item.first)) {
+            return item.first;
+        }
+    };
+
+    /**
+     * @brief Hashes up to batch_size keys and prefetches their first index buckets, then prefetches the items which these
+     * buckets most likely point to. The second pass reads the prefetched buckets, by which time most of them are loaded.
+     *
+     * @param first The first element of the batch.
+     * @param last The end of the elements.
+     * @param key_of Returns the key of an element.
+     * @param hashes Receives the mixed hash of each key.
+     * @param count Receives the number of elements in the batch.
+     *
+     * @return The iterator past the batch.
+     */
+    template <class ForwardIt, class KeyOf>
+    ForwardIt prefetch_batch(const ForwardIt first, const ForwardIt last, KeyOf key_of, std::size_t (&hashes)[batch_size],
+                             std::size_t &count) const {
+        auto it = first;
+        for (; it != last && count < batch_size; ++it, ++count) {
+            hashes[count] = hash_key(key_of(*it));
+            keys_.prefetch(key_of(*it), hashes[count]);
+        }
+
+        auto candidate_it = first;
+        for (std::size_t i = 0; i < count; ++i, ++candidate_it) {
+            const auto slot = keys_.candidate(key_of(*candidate_it), hashes[i]);
+            if (slot != keys_type::no_slot) items_.prefetch(slot);
+        }
+        return it;
+    }
+
+    /**
+     * @brief Marks an item as the most recent one.
+     *
+     * @param index The index of the item or keys_type::no_slot.
+     *
+     * @return A pointer to the item's value or nullptr if @p index is keys_type::no_slot.
+     */
+    const Value *promote(const items_list_index index) noexcept {
+        if (index == keys_type::no_slot) return nullptr;
+
+        items_.move_to_front(index);
+        return &get_front_value();
+    }
+
+    /**
+     * @brief Returns a pointer to the value of the item at @p index, or nullptr if @p index is keys_type::no_slot.
+     */
+    const Value *value_at(const items_list_index index) const noexcept {
+        return index == keys_type::no_slot ? nullptr : &items_.value(index);
+    }
+
+    /**
+     * @brief Dereferences the value of a found item.
+     *
+     * @throws std::out_of_range if @p value is nullptr.
+     */
+    static const Value &checked_value(const Value *value) {
+        if (value == nullptr) {
+            throw_out_of_range("Key not found");
+        }
+
+        return *value;
+    }
+
+    /**
+     * @brief Removes the item at @p index, using its stored hash, if @p index is not keys_type::no_slot.
+     *
+     * @return true if an item was removed.
+     */
+    bool erase_item(const items_list_index index) noexcept {
+        if (index == keys_type::no_slot) return false;
+
+        keys_.erase(items_.key(index), items_.hash(index), index);
+        items_.erase(index);
+        return true;
+    }
+
+    /**
+     * @brief Evicts the least recent item if the lru cache size exceeds the maximum capacity. The evicted key is removed from
+     * the index using its stored hash, so eviction never hashes nor compares keys. The evicted item joins the graveyard
+     * unless it is full.
+     */
+    void restrict_capacity() noexcept {
+        if (items_.size() > capacity_) {
+            const auto victim = items_.tail();
+            keys_.erase(items_.key(victim), items_.hash(victim), victim);
+            // never throws as capacity is always > 0 and items_.size() > capacity
+            if (items_.retired_size() < graveyard_capacity_) {
+                items_.retire_back();
+            } else {
+                items_.pop_back();
+            }
+        }
+    }
+
+    /**
+     * @brief Adds an item, copied or moved, or updates the value of the existing item.
+     */
+    template <class Item>
+    void put_item(Item &&item) {
+        const auto hash = hash_key(item.first);
+        put_item(std::forward<Item>(item), hash);
+    }
+
+    /**
+     * @brief Overload of put_item taking the mixed hash of the item's key.
+     */
+    template <class Item>
+    void put_item(Item &&item, const std::size_t hash) {
+        const auto position = keys_.find_or_prepare_insert(item.first, hash, item_matches<Key>{this, item.first, hash});
+        if (position.slot != keys_type::no_slot) {
+            replace_value(position.slot, std::forward<Item>(item).second);
+        } else if (items_.size() == capacity_ && graveyard_capacity_ == 0) {
+            recycle_least_recent(hash, position.bucket, std::forward<Item>(item), recycling<Item>{});
+        } else {
+            insert_new_item(item.first, hash, position.bucket, std::forward<Item>(item));
+        }
+    }
+
+    /**
+     * @brief Checks if assigning the key and the value of an item to a stored item cannot throw, as for integers and PODs.
+     */
+    template <class Item>
+    using is_nothrow_recyclable_by =
+        std::integral_constant<bool, std::is_nothrow_assignable<Key &, decltype((std::declval<Item>().first))>::value &&
+                                         std::is_nothrow_assignable<Value &, decltype((std::declval<Item>().second))>::value>;
+
+    /**
+     * @brief Tags of the ways a full lru cache adds an item while keeping the strong guarantee: by assigning the item to
+     * the least recent item, by assigning a copy of the item moved into the least recent item, or by constructing a new
+     * item and evicting the least recent one.
+     */
+    struct assign_item {};
+    struct assign_copy {};
+    struct construct_item {};
+
+    /**
+     * @brief Selects how a full lru cache adds an item: only the assignments which cannot throw touch the least recent item.
+     */
+    template <class Item>
+    using recycling = typename std::conditional<
+        is_nothrow_recyclable_by<Item>::value, assign_item,
+        typename std::conditional<is_nothrow_recyclable_by<std::pair<Key, Value>>::value, assign_copy,
+                                  construct_item>::type>::type;
+
+    /**
+     * @brief Matches no item, to find a free bucket for a key which is known to be missing.
+     */
+    struct no_item {
+        bool operator()(const items_list_index /*index*/) const noexcept { return false; }
+    };
+
+    /**
+     * @brief Adds an item to a full lru cache by assigning its key and value to the least recent item, which is unindexed
+     * first and reindexed under its new key. The index holds one key less at that point, so the reindexing never grows it.
+     * None of these steps can throw.
+     *
+     * @param hash The mixed hash of the item's key.
+     * @param item The item to insert.
+     */
+    template <class Item>
+    void recycle_least_recent(const std::size_t hash, const std::size_t /*bucket*/, Item &&item, assign_item) noexcept {
+        const auto victim = items_.tail();
+        keys_.erase(items_.key(victim), items_.hash(victim), victim);
+        reindex_front(hash, items_.recycle_back(static_cast<typename items_list::hash_type>(hash),
+                                                std::forward<Item>(item).first, std::forward<Item>(item).second));
+    }
+
+    /**
+     * @brief Adds an item to a full lru cache by copying it first, which may throw while the cache is untouched, then
+     * moving the copy into the least recent item, which cannot throw.
+     */
+    template <class Item>
+    void recycle_least_recent(const std::size_t hash, const std::size_t bucket, Item &&item, assign_copy) {
+        std::pair<Key, Value> copy(std::forward<Item>(item));
+        recycle_least_recent(hash, bucket, std::move(copy), assign_item{});
+    }
+
+    /**
+     * @brief Indexes a recycled item under its new key.
+     */
+    void reindex_front(const std::size_t hash, const items_list_index index) noexcept {
+        const auto position = keys_.find_or_prepare_insert(items_.key(index), hash, no_item{});
+        keys_.reinsert_at(position.bucket, items_.key(index), hash, index, stored_hash{&items_});
+    }
+
+    /**
+     * @brief Adds an item to a full lru cache whose stored items cannot be moved into without throwing: the new item is
+     * constructed and the least recent item is evicted.
+     */
+    template <class Item>
+    void recycle_least_recent(const std::size_t hash, const std::size_t bucket, Item &&item, construct_item) {
+        insert_new_item(item.first, hash, bucket, std::forward<Item>(item));
+    }
+
+    /**
+     * @brief Adds an item constructed piecewise from a key and the arguments of its value, or, unless @p keep_existing is
+     * set, replaces the value of the existing item.
+     *
+     * @return true if a new item was inserted.
+     */
+    template <class K, class... Args>
+    bool emplace_item(const bool keep_existing, K &&key, Args &&...args) {
+        const auto hash = hash_key(key);
+        const auto position = keys_.find_or_prepare_insert(key, hash, item_matches<Key>{this, key, hash});
+        if (position.slot != keys_type::no_slot) {
+            if (keep_existing) {
+                items_.move_to_front(position.slot);
+            } else {
+                replace_value(position.slot, std::forward<Args>(args)...);
+            }
+            return false;
+        }
+
+        insert_new_item(key, hash, position.bucket, std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+                        std::forward_as_tuple(std::forward<Args>(args)...));
+        return true;
+    }
+
+    /**
+     * @brief Calls a function on the value of the item at @p index, then marks the item as the most recent one.
+     *
+     * @return false if @p index is keys_type::no_slot.
+     */
+    template <class F>
+    bool update_item(const items_list_index index, F &&fn) {
+        if (index == keys_type::no_slot) return false;
+
+        std::forward<F>(fn)(items_.value(index));
+        items_.move_to_front(index);
+        return true;
+    }
+
+    /**
+     * @brief Updates the value of an existing item in place or adds an item with the value made by @p make_fn.
+     *
+     * @return true if a new item was inserted.
+     */
+    template <class K, class Make, class Update>
+    bool upsert_item(K &&key, Make &&make_fn, Update &&update_fn) {
+        const auto hash = hash_key(key);
+        const auto position = keys_.find_or_prepare_insert(key, hash, item_matches<Key>{this, key, hash});
+        if (update_item(position.slot, std::forward<Update>(update_fn))) return false;
+
+        insert_new_item(key, hash, position.bucket, std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+                        std::forward_as_tuple(std::forward<Make>(make_fn)()));
+        return true;
+    }
+
+    /**
+     * @brief Inserts an item as the most recent one to the lru cache. The index makes room for the key before the item is
+     * constructed, so once the item is in the slab nothing can throw and no rollback is needed: if growing the index or
+     * constructing the item throws, the lru cache keeps its items.
+     *
+     * @param key The item's key, which must outlive the construction of the item.
+     * @param hash The mixed hash of the item's key.
+     * @param bucket The index bucket prepared for the item's key.
+     * @param args The arguments forwarded to the item's constructor.
+     */
+    template <class K, class... Args>
+    void insert_new_item(const K &key, const std::size_t hash, const std::size_t bucket, Args &&...args) {
+        if (items_.retired_size() > graveyard_capacity_) items_.release_retired(1);
+        const auto free_bucket = keys_.prepare_insert(bucket, key, hash, stored_hash{&items_});
+        const auto index = items_.push_front(static_cast<typename items_list::hash_type>(hash), std::forward<Args>(args)...);
+        keys_.insert_at(free_bucket, items_.key(index), hash, index, stored_hash{&items_});
+        restrict_capacity();
+    }
+
+    /**
+     * @brief Replaces the value of an item and marks the item as the most recent one. The item is only marked once the new
+     * value is constructed and swapped in, so if either throws, the item keeps both its value and its recency.
+     *
+     * @param index The index of the item.
+     * @param args The arguments forwarded to the new value's constructor.
+     */
+    template <class... Args>
+    void replace_value(const items_list_index index, Args &&...args) {
+        Value value(std::forward<Args>(args)...);
+        std::swap(items_.value(index), value);
+        items_.move_to_front(index);
+    }
+
+    /**
+     * @brief Returns the value of the most recent used item.
+     *
+     * @pre @p items_ must contain at least one item.
+     *
+     * @return The value of the most recent used item.
+     */
+    const Value &get_front_value() const noexcept { return items_.value(items_.head()); }
+
+   protected:
+    std::size_t capacity_;
+    std::size_t graveyard_capacity_{0};
+    Hash hash_;
+    KeyEqual equal_;
+    items_list items_;
+    keys_type keys_;
+};
+
+template <class Key, class Value, class Hash, class KeyEqual, class Items, class Keys>
+constexpr std::size_t lru_cache_base<Key, Value, Hash, KeyEqual, Items, Keys>::batch_size;
+
+}  // namespace detail
+}  // namespace bjg
+
+#endif
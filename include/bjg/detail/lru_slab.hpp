@@ -0,0 +1,1191 @@
+#ifndef BJG_DETAIL_LRU_SLAB_HPP
+#define BJG_DETAIL_LRU_SLAB_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "bjg/detail/allocator_utils.hpp"
+#include "bjg/detail/errors.hpp"
+#include "bjg/detail/guarded_scope.hpp"
+#include "bjg/detail/prefetch.hpp"
+#include "bjg/detail/type_traits.hpp"
+
+namespace bjg {
+namespace detail {
+
+/**
+ * @brief Recency list whose nodes live in a single contiguous block and are linked by integer indices instead of pointers.
+ * With @p Hashes, each node also keeps the hash of its item, so the item never has to be hashed again. Inserting an item
+ * reuses a released node before using a new one. With 16 or 32 bit links, the nodes keep 32 bit hashes, so their metadata
+ * takes 8 or 12 bytes; the caller must then truncate the hashes it passes to hash_type. Without @p Hashes, for items whose
+ * index does not use hashes, the hashes given to the slab are dropped and hash returns 0.
+ *
+ * With @p Generations, each node also has a 32 bit generation, which changes whenever its item is erased, retired or
+ * replaced. The slab has an epoch, which changes whenever all its items are cleared. Together with the index of an item,
+ * they identify the item for its whole lifetime, so a stale reference to an item can be detected without touching the other
+ * nodes.
+ *
+ * The index of an item is stable for its whole lifetime. The block of nodes is owned by @p Derived, which provides
+ * construct_item and destroy_item, given the index of the item, and grow, called when all the nodes are used.
+ *
+ * Clearing the slab or retiring its least recent item does not destroy the items: they are moved onto a list of retired
+ * items, which release_retired destroys in batches. An insertion which finds no free node destroys a retired item before
+ * growing the slab, and the remaining retired items are destroyed with the slab.
+ *
+ * @tparam Derived The slab type which owns the nodes.
+ * @tparam T The type of the items stored in the nodes.
+ * @tparam Index The unsigned integer type of the links. Its maximum value is reserved for npos.
+ * @tparam Generations Whether the nodes have generations, which cost 4 bytes per node.
+ * @tparam Hashes Whether the nodes keep the hashes of their items.
+ */
+template <class Derived, class T, class Index, bool Generations, bool Hashes>
+class lru_slab_base {
+   public:
+    using size_type = Index;
+
+    /**
+     * @brief The stored hashes, as wide as size_t when the links are, 32 bits otherwise.
+     */
+    using hash_type = typename std::conditional<(sizeof(Index) < sizeof(std::size_t)), std::uint32_t, std::size_t>::type;
+
+    /**
+     * @brief The generations of the nodes and the epochs of the slab.
+     */
+    using generation_type = std::uint32_t;
+
+    /**
+     * @brief Whether the nodes have generations, so generation and is_current can be used.
+     */
+    static constexpr bool has_generations = Generations;
+
+    /**
+     * @brief Whether the nodes keep the hashes of their items.
+     */
+    static constexpr bool has_hashes = Hashes;
+
+    /**
+     * @brief Index used as a null link.
+     */
+    static constexpr size_type npos = static_cast<size_type>(-1);
+
+    bool empty() const noexcept { return size_ == 0; }
+
+    size_type size() const noexcept { return size_; }
+
+    /**
+     * @brief Returns the index of the most recent item or npos if the slab is empty.
+     */
+    size_type head() const noexcept { return head_; }
+
+    /**
+     * @brief Returns the index of the least recent item or npos if the slab is empty.
+     */
+    size_type tail() const noexcept { return tail_; }
+
+    /**
+     * @brief Returns the index of the item which is less recent than the item at @p index, or npos.
+     */
+    size_type next(const size_type index) const noexcept { return nodes_[index].next; }
+
+    T &operator[](const size_type index) noexcept { return *nodes_[index].item(); }
+
+    const T &operator[](const size_type index) const noexcept { return *nodes_[index].item(); }
+
+    /**
+     * @brief Returns the key of the item at @p index, when the items are key-value pairs.
+     */
+    template <class Item = T>
+    const typename Item::first_type &key(const size_type index) const noexcept {
+        return nodes_[index].item()->first;
+    }
+
+    /**
+     * @brief Returns the value of the item at @p index, when the items are key-value pairs.
+     */
+    template <class Item = T>
+    typename Item::second_type &value(const size_type index) noexcept {
+        return nodes_[index].item()->second;
+    }
+
+    template <class Item = T>
+    const typename Item::second_type &value(const size_type index) const noexcept {
+        return nodes_[index].item()->second;
+    }
+
+    /**
+     * @brief Returns the hash stored with the item at @p index.
+     */
+    std::size_t hash(const size_type index) const noexcept { return nodes_[index].hash_value(); }
+
+    /**
+     * @brief Returns the generation of the node at @p index.
+     */
+    generation_type generation(const size_type index) const noexcept { return nodes_[index].generation; }
+
+    /**
+     * @brief Returns the epoch of the slab.
+     */
+    generation_type epoch() const noexcept { return epoch_; }
+
+    /**
+     * @brief Checks if the node at @p index still holds the item it held when it had @p generation in @p epoch.
+     */
+    bool is_current(const size_type index, const generation_type generation, const generation_type epoch) const noexcept {
+        return epoch == epoch_ && index < used_ && nodes_[index].generation == generation;
+    }
+
+    /**
+     * @brief Moves the epoch past both its current value and @p epoch, so no reference taken in either epoch is current.
+     */
+    void advance_epoch(const generation_type epoch) noexcept { epoch_ = std::max(epoch_, epoch) + 1; }
+
+    /**
+     * @brief Prefetches the node of the item at @p index.
+     */
+    void prefetch(const size_type index) const noexcept { detail::prefetch(nodes_ + index); }
+
+    /**
+     * @brief Constructs an item in a free node and links it as the most recent one. If the construction throws, the slab is
+     * left unchanged.
+     *
+     * @param hash The hash of the item.
+     * @param args The arguments forwarded to the item's constructor.
+     * @pre size() must be lower than the slab limit.
+     *
+     * @return The index of the new item.
+     */
+    template <class... Args>
+    size_type push_front(const hash_type hash, Args &&...args) {
+        if (free_ == npos && used_ == allocated_) {
+            if (retired_ != npos) {
+                release_retired(1);
+            } else {
+                derived().grow();
+            }
+        }
+
+        const size_type index = free_ != npos ? free_ : used_;
+        derived().construct_item(index, std::forward<Args>(args)...);
+        if (index == free_) {
+            free_ = nodes_[index].next;
+        } else {
+            nodes_[index].reset_generation();
+            ++used_;
+        }
+        nodes_[index].set_hash(hash);
+
+        link_front(index);
+        ++size_;
+        return index;
+    }
+
+    /**
+     * @brief Assigns a new key and value to the least recent item and links it as the most recent one, so the new item
+     * reuses its node and the memory its key and value already own. If an assignment throws, the item stays the least
+     * recent one, with a valid but unspecified key or value.
+     *
+     * @param hash The hash of the new key.
+     * @param key The new key.
+     * @param value The new value.
+     * @pre The slab must not be empty.
+     *
+     * @return The index of the reused item.
+     */
+    template <class KeyArg, class ValueArg>
+    size_type recycle_back(const hash_type hash, KeyArg &&key, ValueArg &&value) {
+        const size_type index = tail_;
+        derived().assign_item(index, std::forward<KeyArg>(key), std::forward<ValueArg>(value));
+        nodes_[index].set_hash(hash);
+        nodes_[index].advance_generation();
+        move_to_front(index);
+        return index;
+    }
+
+    /**
+     * @brief Marks the item at @p index as the most recent one.
+     */
+    void move_to_front(const size_type index) noexcept {
+        if (index == head_) return;
+
+        unlink(index);
+        link_front(index);
+    }
+
+    /**
+     * @brief Destroys the item at @p index and releases its node.
+     */
+    void erase(const size_type index) noexcept {
+        unlink(index);
+        derived().destroy_item(index);
+        nodes_[index].advance_generation();
+        nodes_[index].next = free_;
+        free_ = index;
+        --size_;
+    }
+
+    void pop_front() noexcept { erase(head_); }
+
+    void pop_back() noexcept { erase(tail_); }
+
+    /**
+     * @brief Unlinks the least recent item and retires it, without destroying it.
+     *
+     * @pre The slab must not be empty.
+     */
+    void retire_back() noexcept {
+        const size_type index = tail_;
+        unlink(index);
+        nodes_[index].advance_generation();
+        nodes_[index].next = npos;
+        if (retired_ != npos) {
+            nodes_[retired_tail_].next = index;
+        } else {
+            retired_ = index;
+        }
+        retired_tail_ = index;
+        --size_;
+        ++retired_size_;
+    }
+
+    /**
+     * @brief Returns the number of retired items, which are not destroyed yet.
+     */
+    std::size_t retired_size() const noexcept { return retired_size_; }
+
+    /**
+     * @brief Removes all the items in constant time, by retiring them. The slab keeps its memory.
+     */
+    void clear() noexcept {
+        if (head_ == npos) return;
+
+        if (retired_ != npos) {
+            nodes_[retired_tail_].next = head_;
+        } else {
+            retired_ = head_;
+        }
+        retired_tail_ = tail_;
+        retired_size_ += size_;
+        ++epoch_;
+        head_ = npos;
+        tail_ = npos;
+        size_ = 0;
+    }
+
+    /**
+     * @brief Destroys all the items, linked and retired, and releases all the nodes. The slab keeps its memory.
+     */
+    void reset() noexcept {
+        destroy_items();
+        used_ = 0;
+        free_ = npos;
+        head_ = npos;
+        tail_ = npos;
+        size_ = 0;
+        retired_ = npos;
+        retired_tail_ = npos;
+        retired_size_ = 0;
+        ++epoch_;
+    }
+
+    /**
+     * @brief Destroys up to @p count retired items and releases their nodes.
+     *
+     * @return The number of destroyed items.
+     */
+    std::size_t release_retired(const std::size_t count) noexcept {
+        std::size_t released = 0;
+        for (; released < count && retired_ != npos; ++released) {
+            const size_type index = retired_;
+            retired_ = nodes_[index].next;
+            derived().destroy_item(index);
+            nodes_[index].next = free_;
+            free_ = index;
+        }
+        if (retired_ == npos) retired_tail_ = npos;
+        retired_size_ -= released;
+        return released;
+    }
+
+   protected:
+    /**
+     * @brief The generation of a node, if the nodes have generations.
+     */
+    template <bool HasGeneration, class Dummy = void>
+    struct node_generation {
+        generation_type generation;
+
+        void reset_generation() noexcept { generation = 0; }
+        void advance_generation() noexcept { ++generation; }
+        void copy_generation(const node_generation &other) noexcept { generation = other.generation; }
+    };
+
+    /**
+     * @brief Empty base of the nodes without generations, which then take no space for them.
+     */
+    template <class Dummy>
+    struct node_generation<false, Dummy> {
+        void reset_generation() noexcept {}
+        void advance_generation() noexcept {}
+        void copy_generation(const node_generation & /*other*/) noexcept {}
+    };
+
+    /**
+     * @brief The hash of a node's item, on top of its generation, if the nodes keep hashes.
+     */
+    template <bool HasHash, class Base>
+    struct node_hash : Base {
+        hash_type hash;
+
+        std::size_t hash_value() const noexcept { return hash; }
+        void set_hash(const hash_type value) noexcept { hash = value; }
+        void copy_hash(const node_hash &other) noexcept { hash = other.hash; }
+    };
+
+    /**
+     * @brief Base of the nodes without hashes, which then take no space for them.
+     */
+    template <class Base>
+    struct node_hash<false, Base> : Base {
+        std::size_t hash_value() const noexcept { return 0; }
+        void set_hash(const hash_type /*value*/) noexcept {}
+        void copy_hash(const node_hash & /*other*/) noexcept {}
+    };
+
+    struct node : node_hash<Hashes, node_generation<Generations>> {
+        size_type prev;
+        size_type next;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T *item() noexcept { return reinterpret_cast<T *>(storage); }
+    };
+
+    lru_slab_base() = default;
+    lru_slab_base(const lru_slab_base &) = delete;
+    lru_slab_base &operator=(const lru_slab_base &) = delete;
+    ~lru_slab_base() = default;
+
+    Derived &derived() noexcept { return static_cast<Derived &>(*this); }
+
+    /**
+     * @brief Assigns a key and a value to the key-value pair at @p index.
+     */
+    template <class KeyArg, class ValueArg>
+    void assign_item(const size_type index, KeyArg &&key, ValueArg &&value) {
+        nodes_[index].item()->first = std::forward<KeyArg>(key);
+        nodes_[index].item()->second = std::forward<ValueArg>(value);
+    }
+
+    /**
+     * @brief Constructs the items of this slab in other nodes, at the same indices, and copies the links and the hashes of
+     * the used nodes into @p nodes. If constructing an item throws, the items already constructed are destroyed.
+     *
+     * @param nodes The nodes to clone into, at least used_.
+     * @param construct Constructs the item at the given index in the other nodes from the item at this index in this slab.
+     * @param destroy Destroys the item constructed by @p construct at the given index.
+     */
+    template <class Construct, class Destroy>
+    void clone_into(node *nodes, Construct construct, Destroy destroy) const {
+        size_type current = head_;
+        auto guard = make_guarded_scope([this, &destroy, &current]() {
+            for (auto index = head_; index != current; index = nodes_[index].next) destroy(index);
+        });
+
+        for (; current != npos; current = nodes_[current].next) construct(current);
+        guard.dismiss();
+
+        for (size_type index = 0; index < used_; ++index) {
+            nodes[index].prev = nodes_[index].prev;
+            nodes[index].next = nodes_[index].next;
+            nodes[index].copy_hash(nodes_[index]);
+            nodes[index].copy_generation(nodes_[index]);
+        }
+    }
+
+    /**
+     * @brief Destroys the items, both linked and retired.
+     */
+    void destroy_items() noexcept {
+        for (auto index = head_; index != npos; index = nodes_[index].next) derived().destroy_item(index);
+        for (auto index = retired_; index != npos; index = nodes_[index].next) derived().destroy_item(index);
+    }
+
+    /**
+     * @brief Copies the links of @p other, whose linked items were cloned into this slab. The nodes of its retired items,
+     * which were not cloned, are free in this slab.
+     */
+    void copy_links(const lru_slab_base &other) noexcept {
+        used_ = other.used_;
+        free_ = other.free_;
+        head_ = other.head_;
+        tail_ = other.tail_;
+        size_ = other.size_;
+        retired_ = other.retired_;
+        retired_tail_ = other.retired_tail_;
+        retired_size_ = other.retired_size_;
+        epoch_ = other.epoch_;
+        free_retired_nodes();
+    }
+
+    /**
+     * @brief Moves the nodes of the retired items to the free nodes, once the items are destroyed or were never constructed
+     * in these nodes.
+     */
+    void free_retired_nodes() noexcept {
+        if (retired_ == npos) return;
+
+        nodes_[retired_tail_].next = free_;
+        free_ = retired_;
+        retired_ = npos;
+        retired_tail_ = npos;
+        retired_size_ = 0;
+    }
+
+    void swap_links(lru_slab_base &other) noexcept {
+        std::swap(nodes_, other.nodes_);
+        std::swap(allocated_, other.allocated_);
+        std::swap(used_, other.used_);
+        std::swap(free_, other.free_);
+        std::swap(head_, other.head_);
+        std::swap(tail_, other.tail_);
+        std::swap(size_, other.size_);
+        std::swap(retired_, other.retired_);
+        std::swap(retired_tail_, other.retired_tail_);
+        std::swap(retired_size_, other.retired_size_);
+        std::swap(epoch_, other.epoch_);
+    }
+
+    node *nodes_{nullptr};
+    size_type allocated_{0};
+    size_type used_{0};
+    size_type free_{npos};
+    size_type head_{npos};
+    size_type tail_{npos};
+    size_type size_{0};
+    size_type retired_{npos};
+    size_type retired_tail_{npos};
+    std::size_t retired_size_{0};
+    generation_type epoch_{0};
+
+   private:
+    void link_front(const size_type index) noexcept {
+        nodes_[index].prev = npos;
+        nodes_[index].next = head_;
+        if (head_ != npos) {
+            nodes_[head_].prev = index;
+        } else {
+            tail_ = index;
+        }
+        head_ = index;
+    }
+
+    void unlink(const size_type index) noexcept {
+        const auto prev = nodes_[index].prev;
+        const auto next = nodes_[index].next;
+        if (prev != npos) {
+            nodes_[prev].next = next;
+        } else {
+            head_ = next;
+        }
+        if (next != npos) {
+            nodes_[next].prev = prev;
+        } else {
+            tail_ = prev;
+        }
+    }
+};
+
+template <class Derived, class T, class Index, bool Generations, bool Hashes>
+constexpr typename lru_slab_base<Derived, T, Index, Generations, Hashes>::size_type
+    lru_slab_base<Derived, T, Index, Generations, Hashes>::npos;
+
+template <class Derived, class T, class Index, bool Generations, bool Hashes>
+constexpr bool lru_slab_base<Derived, T, Index, Generations, Hashes>::has_generations;
+
+template <class Derived, class T, class Index, bool Generations, bool Hashes>
+constexpr bool lru_slab_base<Derived, T, Index, Generations, Hashes>::has_hashes;
+
+/**
+ * @brief Slab allocated on the heap, which grows geometrically until it holds @p limit nodes. From then on, inserting an
+ * item never allocates. Growing relocates the items, so references to them are invalidated by any insertion.
+ *
+ * The nodes are allocated and the items are constructed through @p Allocator, which follows the allocator propagation
+ * rules of the standard containers. The allocator must use raw pointers.
+ *
+ * @tparam T The type of the stored items.
+ * @tparam Allocator The allocator of the items, rebound to allocate the nodes.
+ * @tparam Index The unsigned integer type of the links.
+ * @tparam Generations Whether the nodes have generations, for the handles of the items.
+ * @tparam Hashes Whether the nodes keep the hashes of their items.
+ */
+template <class T, class Allocator = std::allocator<T>, class Index = std::size_t, bool Generations = false,
+          bool Hashes = true>
+class lru_slab
+    : public lru_slab_base<lru_slab<T, Allocator, Index, Generations, Hashes>, T, Index, Generations, Hashes> {
+    using base = lru_slab_base<lru_slab<T, Allocator, Index, Generations, Hashes>, T, Index, Generations, Hashes>;
+    friend base;
+
+   public:
+    using typename base::size_type;
+    using allocator_type = Allocator;
+
+    /**
+     * @brief Creates an empty slab. No memory is allocated until the first insertion.
+     *
+     * @param limit The maximum number of nodes the slab can hold, lower than npos.
+     * @param alloc The allocator of the nodes and of the items.
+     */
+    explicit lru_slab(const size_type limit, const Allocator &alloc = Allocator()) noexcept : alloc_(alloc), limit_{limit} {}
+
+    lru_slab(const lru_slab &other) : lru_slab(other, traits::select_on_container_copy_construction(other.alloc_)) {}
+
+    lru_slab(const lru_slab &other, const Allocator &alloc) : alloc_(alloc), limit_{other.limit_} {
+        if (other.allocated_ == 0) return;
+
+        this->nodes_ = checked_allocation(
+            other.clone_nodes(alloc_, other.allocated_, [this](T *slot, T *item) { construct_at(slot, *item); }));
+        this->allocated_ = other.allocated_;
+        this->copy_links(other);
+    }
+
+    lru_slab(lru_slab &&other) noexcept : alloc_(std::move(other.alloc_)), limit_{other.limit_} { this->swap_links(other); }
+
+    lru_slab(lru_slab &&other, const Allocator &alloc) : alloc_(alloc), limit_{other.limit_} {
+        if (alloc_ == other.alloc_) {
+            this->swap_links(other);
+        } else if (other.allocated_ != 0) {
+            this->nodes_ = checked_allocation(other.clone_nodes(
+                alloc_, other.allocated_, [this](T *slot, T *item) { construct_at(slot, std::move_if_noexcept(*item)); }));
+            this->allocated_ = other.allocated_;
+            this->copy_links(other);
+        }
+    }
+
+    lru_slab &operator=(const lru_slab &other) {
+        if (this != &other) {
+            lru_slab copy{other, traits::propagate_on_container_copy_assignment::value ? other.alloc_ : alloc_};
+            swap_state(copy);
+            swap_allocators(alloc_, copy.alloc_, typename traits::propagate_on_container_copy_assignment{});
+        }
+        return *this;
+    }
+
+    lru_slab &operator=(lru_slab &&other) noexcept(traits::propagate_on_container_move_assignment::value) {
+        if (this != &other) {
+            lru_slab moved{std::move(other), traits::propagate_on_container_move_assignment::value ? other.alloc_ : alloc_};
+            swap_state(moved);
+            swap_allocators(alloc_, moved.alloc_, typename traits::propagate_on_container_move_assignment{});
+        }
+        return *this;
+    }
+
+    ~lru_slab() {
+        this->destroy_items();
+        deallocate(alloc_, this->nodes_, this->allocated_);
+    }
+
+    /**
+     * @brief Swaps the content of two slabs. The allocators are swapped only if they propagate on swap, otherwise they must
+     * be equal.
+     */
+    void swap(lru_slab &other) noexcept {
+        swap_state(other);
+        swap_allocators(alloc_, other.alloc_, typename traits::propagate_on_container_swap{});
+    }
+
+    allocator_type get_allocator() const noexcept { return alloc_; }
+
+    /**
+     * @brief Allocates room for @p count nodes, up to the slab limit, so that no allocation takes place until they are all
+     * used.
+     *
+     * @param count The number of nodes to make room for.
+     */
+    void reserve(const std::size_t count) {
+        if (!try_reserve(count)) throw_bad_alloc();
+    }
+
+    /**
+     * @brief Allocates room for @p count nodes, as reserve does, but reports an allocator returning nullptr instead of
+     * raising std::bad_alloc.
+     *
+     * @return false if the allocation failed, in which case the slab is left unchanged.
+     */
+    bool try_reserve(const std::size_t count) {
+        const auto capped_count = static_cast<size_type>(std::min<std::size_t>(count, limit_));
+        return capped_count <= this->allocated_ || try_reallocate(capped_count);
+    }
+
+    /**
+     * @brief Raises the slab limit to @p count nodes, if it is lower, and allocates them.
+     *
+     * @throws std::length_error if @p count nodes cannot be addressed by Index.
+     */
+    void extend(const std::size_t count) {
+        if (count >= static_cast<std::size_t>(base::npos)) {
+            throw_length_error("Slab limit exceeded");
+        }
+
+        if (count > this->allocated_) reallocate(static_cast<size_type>(count));
+        limit_ = std::max(limit_, static_cast<size_type>(count));
+    }
+
+   private:
+    using node = typename base::node;
+    using traits = std::allocator_traits<Allocator>;
+    using node_allocator = typename traits::template rebind_alloc<node>;
+
+    static constexpr size_type min_allocation = 16;
+
+    static node *allocate(const Allocator &alloc, const size_type count) {
+        node_allocator nodes_alloc(alloc);
+        return std::allocator_traits<node_allocator>::allocate(nodes_alloc, count);
+    }
+
+    static void deallocate(const Allocator &alloc, node *nodes, const size_type count) noexcept {
+        if (nodes == nullptr) return;
+
+        node_allocator nodes_alloc(alloc);
+        std::allocator_traits<node_allocator>::deallocate(nodes_alloc, nodes, count);
+    }
+
+    template <class... Args>
+    void construct_at(T *slot, Args &&...args) {
+        traits::construct(alloc_, slot, std::forward<Args>(args)...);
+    }
+
+    template <class... Args>
+    void construct_item(const size_type index, Args &&...args) {
+        construct_at(this->nodes_[index].item(), std::forward<Args>(args)...);
+    }
+
+    void destroy_item(const size_type index) noexcept { traits::destroy(alloc_, this->nodes_[index].item()); }
+
+    /**
+     * @brief Allocates @p count nodes holding the links, the hashes and the items of this slab at the same indices. If
+     * constructing an item throws, the new nodes are released and this slab is left unchanged.
+     *
+     * @param alloc The allocator of the new nodes and items.
+     * @param count The number of nodes to allocate, at least used_.
+     * @param construct Constructs an item in the given slot from the given item of this slab.
+     *
+     * @return The new nodes, or nullptr if the allocator returned nullptr.
+     */
+    template <class Construct>
+    node *clone_nodes(Allocator &alloc, const size_type count, Construct construct) const {
+        node *const nodes = allocate(alloc, count);
+        if (nodes == nullptr) return nullptr;
+
+        auto guard = make_guarded_scope([&alloc, nodes, count]() { deallocate(alloc, nodes, count); });
+        this->clone_into(
+            nodes,
+            [this, nodes, &construct](const size_type index) { construct(nodes[index].item(), this->nodes_[index].item()); },
+            [&alloc, nodes](const size_type index) { traits::destroy(alloc, nodes[index].item()); });
+        guard.dismiss();
+        return nodes;
+    }
+
+    /**
+     * @brief Grows the slab geometrically, up to its limit.
+     */
+    void grow() {
+        const size_type allocated = this->allocated_;
+        const size_type count = allocated > limit_ / 2
+                                    ? limit_
+                                    : std::min(std::max(static_cast<size_type>(allocated * 2), min_allocation), limit_);
+        if (count <= allocated) {
+            throw_length_error("Slab limit exceeded");
+        }
+
+        reallocate(count);
+    }
+
+    void reallocate(const size_type count) {
+        if (!try_reallocate(count)) throw_bad_alloc();
+    }
+
+    /**
+     * @brief Moves the items into a slab of @p count nodes, or copies them if T's move constructor may throw.
+     *
+     * @return false if the allocator returned nullptr, in which case the slab is left unchanged.
+     */
+    bool try_reallocate(const size_type count) {
+        node *const nodes =
+            clone_nodes(alloc_, count, [this](T *slot, T *item) { construct_at(slot, std::move_if_noexcept(*item)); });
+        if (nodes == nullptr) return false;
+
+        this->destroy_items();
+        deallocate(alloc_, this->nodes_, this->allocated_);
+        this->nodes_ = nodes;
+        this->allocated_ = count;
+        this->free_retired_nodes();
+        return true;
+    }
+
+    void swap_state(lru_slab &other) noexcept {
+        std::swap(limit_, other.limit_);
+        this->swap_links(other);
+    }
+
+    Allocator alloc_;
+    size_type limit_;
+};
+
+template <class T, class Allocator, class Index, bool Generations, bool Hashes>
+constexpr typename lru_slab<T, Allocator, Index, Generations, Hashes>::size_type
+    lru_slab<T, Allocator, Index, Generations, Hashes>::min_allocation;
+
+/**
+ * @brief Heap slab storing its items as two parallel arrays: the nodes hold the links, the hashes and the keys, while the
+ * values live in a separate block at the same indices. Probing the keys and walking the recency list only touch the nodes,
+ * so they stay dense in the cache whatever the size of the values.
+ *
+ * Like lru_slab, it grows geometrically until it holds @p limit nodes, relocates the items when growing and follows the
+ * allocator propagation rules of the standard containers. The allocator must use raw pointers.
+ *
+ * @tparam Key The type of the keys, stored in the nodes.
+ * @tparam Value The type of the values, stored apart.
+ * @tparam Allocator The allocator of the items, rebound to allocate the nodes and the values.
+ * @tparam Index The unsigned integer type of the links.
+ * @tparam Generations Whether the nodes have generations, for the handles of the items.
+ * @tparam Hashes Whether the nodes keep the hashes of their items.
+ */
+template <class Key, class Value, class Allocator = std::allocator<std::pair<const Key, Value>>, class Index = std::size_t,
+          bool Generations = false, bool Hashes = true>
+class split_lru_slab : public lru_slab_base<split_lru_slab<Key, Value, Allocator, Index, Generations, Hashes>, Key, Index,
+                                            Generations, Hashes> {
+    using base =
+        lru_slab_base<split_lru_slab<Key, Value, Allocator, Index, Generations, Hashes>, Key, Index, Generations, Hashes>;
+    friend base;
+
+   public:
+    using typename base::size_type;
+    using allocator_type = Allocator;
+
+    /**
+     * @brief Creates an empty slab. No memory is allocated until the first insertion.
+     *
+     * @param limit The maximum number of nodes the slab can hold, lower than npos.
+     * @param alloc The allocator of the nodes and of the items.
+     */
+    explicit split_lru_slab(const size_type limit, const Allocator &alloc = Allocator()) noexcept
+        : alloc_(alloc), limit_{limit} {}
+
+    split_lru_slab(const split_lru_slab &other)
+        : split_lru_slab(other, traits::select_on_container_copy_construction(other.alloc_)) {}
+
+    split_lru_slab(const split_lru_slab &other, const Allocator &alloc) : alloc_(alloc), limit_{other.limit_} {
+        if (other.allocated_ == 0) return;
+
+        adopt(checked_blocks(other.clone_blocks(alloc_, other.allocated_, copy_source{})), other.allocated_);
+        this->copy_links(other);
+    }
+
+    split_lru_slab(split_lru_slab &&other) noexcept : alloc_(std::move(other.alloc_)), limit_{other.limit_} {
+        swap_blocks(other);
+    }
+
+    split_lru_slab(split_lru_slab &&other, const Allocator &alloc) : alloc_(alloc), limit_{other.limit_} {
+        if (alloc_ == other.alloc_) {
+            swap_blocks(other);
+        } else if (other.allocated_ != 0) {
+            adopt(checked_blocks(other.clone_blocks(alloc_, other.allocated_, move_source{})), other.allocated_);
+            this->copy_links(other);
+        }
+    }
+
+    split_lru_slab &operator=(const split_lru_slab &other) {
+        if (this != &other) {
+            split_lru_slab copy{other, traits::propagate_on_container_copy_assignment::value ? other.alloc_ : alloc_};
+            swap_state(copy);
+            swap_allocators(alloc_, copy.alloc_, typename traits::propagate_on_container_copy_assignment{});
+        }
+        return *this;
+    }
+
+    split_lru_slab &operator=(split_lru_slab &&other) noexcept(traits::propagate_on_container_move_assignment::value) {
+        if (this != &other) {
+            split_lru_slab moved{std::move(other),
+                                 traits::propagate_on_container_move_assignment::value ? other.alloc_ : alloc_};
+            swap_state(moved);
+            swap_allocators(alloc_, moved.alloc_, typename traits::propagate_on_container_move_assignment{});
+        }
+        return *this;
+    }
+
+    ~split_lru_slab() {
+        this->destroy_items();
+        deallocate(alloc_, blocks{this->nodes_, values_}, this->allocated_);
+    }
+
+    /**
+     * @brief Swaps the content of two slabs. The allocators are swapped only if they propagate on swap, otherwise they must
+     * be equal.
+     */
+    void swap(split_lru_slab &other) noexcept {
+        swap_state(other);
+        swap_allocators(alloc_, other.alloc_, typename traits::propagate_on_container_swap{});
+    }
+
+    allocator_type get_allocator() const noexcept { return alloc_; }
+
+    /**
+     * @brief Returns the key of the item at @p index.
+     */
+    const Key &key(const size_type index) const noexcept { return *this->nodes_[index].item(); }
+
+    /**
+     * @brief Returns the value of the item at @p index.
+     */
+    Value &value(const size_type index) noexcept { return values_[index]; }
+
+    const Value &value(const size_type index) const noexcept { return values_[index]; }
+
+    /**
+     * @brief Allocates room for @p count nodes and values, up to the slab limit, so that no allocation takes place until
+     * they are all used.
+     *
+     * @param count The number of items to make room for.
+     */
+    void reserve(const std::size_t count) {
+        if (!try_reserve(count)) throw_bad_alloc();
+    }
+
+    /**
+     * @brief Allocates room for @p count nodes and values, as reserve does, but reports an allocator returning nullptr
+     * instead of raising std::bad_alloc.
+     *
+     * @return false if the allocation failed, in which case the slab is left unchanged.
+     */
+    bool try_reserve(const std::size_t count) {
+        const auto capped_count = static_cast<size_type>(std::min<std::size_t>(count, limit_));
+        return capped_count <= this->allocated_ || try_reallocate(capped_count);
+    }
+
+    /**
+     * @brief Raises the slab limit to @p count items, if it is lower, and allocates their nodes and values.
+     *
+     * @throws std::length_error if @p count nodes cannot be addressed by Index.
+     */
+    void extend(const std::size_t count) {
+        if (count >= static_cast<std::size_t>(base::npos)) {
+            throw_length_error("Slab limit exceeded");
+        }
+
+        if (count > this->allocated_) reallocate(static_cast<size_type>(count));
+        limit_ = std::max(limit_, static_cast<size_type>(count));
+    }
+
+   private:
+    using node = typename base::node;
+    using traits = std::allocator_traits<Allocator>;
+    using node_allocator = typename traits::template rebind_alloc<node>;
+    using value_allocator = typename traits::template rebind_alloc<Value>;
+
+    static constexpr size_type min_allocation = 16;
+
+    /**
+     * @brief The nodes and the values of a slab, allocated with the same number of elements.
+     */
+    struct blocks {
+        node *nodes;
+        Value *values;
+    };
+
+    struct copy_source {
+        template <class U>
+        const U &operator()(U &item) const noexcept {
+            return item;
+        }
+    };
+
+    struct move_source {
+        template <class U>
+        auto operator()(U &item) const noexcept -> decltype(std::move_if_noexcept(item)) {
+            return std::move_if_noexcept(item);
+        }
+    };
+
+    /**
+     * @brief Allocates the nodes and the values of @p count items. If the allocator returns nullptr for either block, no
+     * block is kept and both returned blocks are nullptr.
+     */
+    static blocks allocate(const Allocator &alloc, const size_type count) {
+        node_allocator nodes_alloc(alloc);
+        node *const nodes = std::allocator_traits<node_allocator>::allocate(nodes_alloc, count);
+        if (nodes == nullptr) return blocks{nullptr, nullptr};
+
+        auto guard = make_guarded_scope(
+            [&nodes_alloc, nodes, count]() { std::allocator_traits<node_allocator>::deallocate(nodes_alloc, nodes, count); });
+        value_allocator values_alloc(alloc);
+        Value *const values = std::allocator_traits<value_allocator>::allocate(values_alloc, count);
+        if (values == nullptr) return blocks{nullptr, nullptr};
+
+        guard.dismiss();
+        return blocks{nodes, values};
+    }
+
+    /**
+     * @brief Returns blocks returned by allocate or clone_blocks, raising std::bad_alloc if their allocation failed.
+     */
+    static blocks checked_blocks(const blocks target) {
+        checked_allocation(target.nodes);
+        return target;
+    }
+
+    static void deallocate(const Allocator &alloc, const blocks target, const size_type count) noexcept {
+        if (target.nodes == nullptr) return;
+
+        node_allocator nodes_alloc(alloc);
+        std::allocator_traits<node_allocator>::deallocate(nodes_alloc, target.nodes, count);
+        value_allocator values_alloc(alloc);
+        std::allocator_traits<value_allocator>::deallocate(values_alloc, target.values, count);
+    }
+
+    /**
+     * @brief Constructs the key and the value of the item at @p index in @p target. If the value's construction throws, the
+     * key is destroyed.
+     */
+    template <class KeyArg, class... ValueArgs>
+    static void construct_at(Allocator &alloc, const blocks target, const size_type index, KeyArg &&key,
+                             ValueArgs &&...value_args) {
+        traits::construct(alloc, target.nodes[index].item(), std::forward<KeyArg>(key));
+        auto guard = make_guarded_scope([&alloc, target, index]() { traits::destroy(alloc, target.nodes[index].item()); });
+        traits::construct(alloc, target.values + index, std::forward<ValueArgs>(value_args)...);
+        guard.dismiss();
+    }
+
+    static void destroy_at(Allocator &alloc, const blocks target, const size_type index) noexcept {
+        traits::destroy(alloc, target.values + index);
+        traits::destroy(alloc, target.nodes[index].item());
+    }
+
+    /**
+     * @brief Constructs the item at @p index from a key-value pair, copied or moved.
+     */
+    template <class Item>
+    void construct_item(const size_type index, Item &&item) {
+        construct_at(alloc_, blocks{this->nodes_, values_}, index, std::forward<Item>(item).first,
+                     std::forward<Item>(item).second);
+    }
+
+    /**
+     * @brief Constructs the item at @p index piecewise, as std::pair does: the key from a single argument and the value from
+     * the arguments of its tuple.
+     */
+    template <class KeyArg, class... ValueArgs>
+    void construct_item(const size_type index, std::piecewise_construct_t, std::tuple<KeyArg> key_args,
+                        std::tuple<ValueArgs...> value_args) {
+        construct_piecewise(index, key_args, value_args, make_index_sequence<sizeof...(ValueArgs)>{});
+    }
+
+    template <class KeyArg, class... ValueArgs, std::size_t... I>
+    void construct_piecewise(const size_type index, std::tuple<KeyArg> &key_args, std::tuple<ValueArgs...> &value_args,
+                             index_sequence<I...>) {
+        construct_at(alloc_, blocks{this->nodes_, values_}, index, std::forward<KeyArg>(std::get<0>(key_args)),
+                     std::forward<ValueArgs>(std::get<I>(value_args))...);
+    }
+
+    void destroy_item(const size_type index) noexcept { destroy_at(alloc_, blocks{this->nodes_, values_}, index); }
+
+    template <class KeyArg, class ValueArg>
+    void assign_item(const size_type index, KeyArg &&key, ValueArg &&value) {
+        *this->nodes_[index].item() = std::forward<KeyArg>(key);
+        values_[index] = std::forward<ValueArg>(value);
+    }
+
+    /**
+     * @brief Allocates @p count nodes and values holding the links, the hashes and the items of this slab at the same
+     * indices. If constructing an item throws, the new blocks are released and this slab is left unchanged.
+     *
+     * @param alloc The allocator of the new blocks and items.
+     * @param count The number of items to allocate, at least used_.
+     * @param source Returns the argument which the new keys and values are constructed from, given those of this slab.
+     *
+     * @return The new blocks, which are nullptr if the allocator returned nullptr.
+     */
+    template <class Source>
+    blocks clone_blocks(Allocator &alloc, const size_type count, Source source) const {
+        const blocks target = allocate(alloc, count);
+        if (target.nodes == nullptr) return target;
+
+        auto guard = make_guarded_scope([&alloc, target, count]() { deallocate(alloc, target, count); });
+        this->clone_into(
+            target.nodes,
+            [this, &alloc, target, &source](const size_type index) {
+                construct_at(alloc, target, index, source(*this->nodes_[index].item()), source(values_[index]));
+            },
+            [&alloc, target](const size_type index) { destroy_at(alloc, target, index); });
+        guard.dismiss();
+        return target;
+    }
+
+    void adopt(const blocks target, const size_type count) noexcept {
+        this->nodes_ = target.nodes;
+        values_ = target.values;
+        this->allocated_ = count;
+    }
+
+    /**
+     * @brief Grows the slab geometrically, up to its limit.
+     */
+    void grow() {
+        const size_type allocated = this->allocated_;
+        const size_type count = allocated > limit_ / 2
+                                    ? limit_
+                                    : std::min(std::max(static_cast<size_type>(allocated * 2), min_allocation), limit_);
+        if (count <= allocated) {
+            throw_length_error("Slab limit exceeded");
+        }
+
+        reallocate(count);
+    }
+
+    void reallocate(const size_type count) {
+        if (!try_reallocate(count)) throw_bad_alloc();
+    }
+
+    /**
+     * @brief Moves the items into blocks of @p count items, or copies them if their move constructors may throw.
+     *
+     * @return false if the allocator returned nullptr, in which case the slab is left unchanged.
+     */
+    bool try_reallocate(const size_type count) {
+        const blocks target = clone_blocks(alloc_, count, move_source{});
+        if (target.nodes == nullptr) return false;
+
+        this->destroy_items();
+        deallocate(alloc_, blocks{this->nodes_, values_}, this->allocated_);
+        adopt(target, count);
+        this->free_retired_nodes();
+        return true;
+    }
+
+    void swap_blocks(split_lru_slab &other) noexcept {
+        this->swap_links(other);
+        std::swap(values_, other.values_);
+    }
+
+    void swap_state(split_lru_slab &other) noexcept {
+        std::swap(limit_, other.limit_);
+        swap_blocks(other);
+    }
+
+    Allocator alloc_;
+    size_type limit_;
+    Value *values_{nullptr};
+};
+
+template <class Key, class Value, class Allocator, class Index, bool Generations, bool Hashes>
+constexpr typename split_lru_slab<Key, Value, Allocator, Index, Generations, Hashes>::size_type
+    split_lru_slab<Key, Value, Allocator, Index, Generations, Hashes>::min_allocation;
+
+/**
+ * @brief Slab holding its @p N nodes inline, so it never allocates. Copying or moving it copies or moves the items, and a
+ * failed assignment leaves it empty.
+ *
+ * @tparam T The type of the stored items.
+ * @tparam N The number of nodes, lower than npos.
+ * @tparam Index The unsigned integer type of the links.
+ * @tparam Generations Whether the nodes have generations, for the handles of the items.
+ */
+template <class T, std::size_t N, class Index, bool Generations = false>
+class static_lru_slab : public lru_slab_base<static_lru_slab<T, N, Index, Generations>, T, Index, Generations, true> {
+    using base = lru_slab_base<static_lru_slab<T, N, Index, Generations>, T, Index, Generations, true>;
+    friend base;
+
+    static_assert(N > 0 && N < static_cast<std::size_t>(base::npos), "The nodes must be addressable by Index");
+
+   public:
+    using typename base::size_type;
+
+    static_lru_slab() noexcept { reset_nodes(); }
+
+    static_lru_slab(const static_lru_slab &other) {
+        reset_nodes();
+        copy_items(other);
+    }
+
+    static_lru_slab(static_lru_slab &&other) noexcept(std::is_nothrow_move_constructible<T>::value) {
+        reset_nodes();
+        take_items(other);
+    }
+
+    static_lru_slab &operator=(const static_lru_slab &other) {
+        if (this != &other) {
+            this->reset();
+            copy_items(other);
+        }
+        return *this;
+    }
+
+    static_lru_slab &operator=(static_lru_slab &&other) noexcept(std::is_nothrow_move_constructible<T>::value) {
+        if (this != &other) {
+            this->reset();
+            take_items(other);
+        }
+        return *this;
+    }
+
+    ~static_lru_slab() { this->destroy_items(); }
+
+    /**
+     * @brief Does nothing, all the nodes are always available.
+     */
+    void reserve(std::size_t /*count*/) noexcept {}
+
+    /**
+     * @brief Does nothing, the slab never holds more than its @p N nodes.
+     */
+    void extend(std::size_t /*count*/) noexcept {}
+
+   private:
+    using node = typename base::node;
+
+    template <class... Args>
+    void construct_item(const size_type index, Args &&...args) {
+        ::new (static_cast<void *>(this->nodes_[index].item())) T(std::forward<Args>(args)...);
+    }
+
+    void destroy_item(const size_type index) noexcept { this->nodes_[index].item()->~T(); }
+
+    [[noreturn]] static void grow() { throw_length_error("Slab limit exceeded"); }
+
+    void reset_nodes() noexcept {
+        this->nodes_ = nodes_storage_;
+        this->allocated_ = static_cast<size_type>(N);
+    }
+
+    /**
+     * @brief Copies the items of @p other into this empty slab.
+     */
+    void copy_items(const static_lru_slab &other) {
+        other.clone_into(
+            this->nodes_, [this, &other](const size_type index) { construct_item(index, other[index]); },
+            [this](const size_type index) { destroy_item(index); });
+        this->copy_links(other);
+    }
+
+    /**
+     * @brief Moves the items of @p other into this empty slab. @p other is left empty.
+     */
+    void take_items(static_lru_slab &other) {
+        other.clone_into(
+            this->nodes_, [this, &other](const size_type index) { construct_item(index, std::move(other[index])); },
+            [this](const size_type index) { destroy_item(index); });
+        this->copy_links(other);
+        other.reset();
+    }
+
+    node nodes_storage_[N];
+};
+
+}  // namespace detail
+}  // namespace bjg
+
+#endif
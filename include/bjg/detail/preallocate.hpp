@@ -0,0 +1,20 @@
+#ifndef BJG_DETAIL_PREALLOCATE_HPP
+#define BJG_DETAIL_PREALLOCATE_HPP
+
+namespace bjg {
+
+/**
+ * @brief Tag type selecting the cache constructors which allocate all the storage up front.
+ */
+struct preallocate_t {
+    explicit preallocate_t() = default;
+};
+
+/**
+ * @brief Tag selecting the cache constructors which allocate all the storage up front.
+ */
+constexpr preallocate_t preallocate{};
+
+}  // namespace bjg
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef BJG_DETAIL_PREFETCH_HPP
+#define BJG_DETAIL_PREFETCH_HPP
+
+#if defined(_MSC_VER) && !defined(__clang__) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
+namespace bjg {
+namespace detail {
+
+/**
+ * @brief Hints the processor to load the cache line of @p address for reading. It never faults, whatever the address, and
+ * does nothing on compilers without a prefetch intrinsic.
+ */
+inline void prefetch(const void *address) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_prefetch(static_cast<const char *>(address), _MM_HINT_T0);
+#else
+    static_cast<void>(address);
+#endif
+}
+
+}  // namespace detail
+}  // namespace bjg
+
+#endif
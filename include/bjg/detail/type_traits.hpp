@@ -0,0 +1,70 @@
+#ifndef BJG_DETAIL_TYPE_TRAITS_HPP
+#define BJG_DETAIL_TYPE_TRAITS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace bjg {
+namespace detail {
+
+template <class...>
+struct make_void {
+    using type = void;
+};
+
+/**
+ * @brief Checks if @p T declares an is_transparent member type, as the hash and equality functions supporting lookups by
+ * keys of other types do.
+ */
+template <class T, class = void>
+struct is_transparent : std::false_type {};
+
+template <class T>
+struct is_transparent<T, typename make_void<typename T::is_transparent>::type> : std::true_type {};
+
+/**
+ * @brief Enables the heterogeneous lookup overloads for the key type @p K when both @p Hash and @p KeyEqual are transparent.
+ */
+template <class Hash, class KeyEqual, class K>
+using enable_if_transparent = typename std::enable_if<is_transparent<Hash>::value && is_transparent<KeyEqual>::value, K>::type;
+
+/**
+ * @brief Checks if std::swap of two @p T, which moves them, cannot throw.
+ */
+template <class T>
+struct is_nothrow_swappable_by_move
+    : std::integral_constant<bool,
+                             std::is_nothrow_move_constructible<T>::value && std::is_nothrow_move_assignable<T>::value> {};
+
+/**
+ * @brief Selects the narrowest unsigned integer type, of at least 16 bits, which can index @p Count elements and still
+ * reserve its maximum value as a null index.
+ */
+template <std::size_t Count>
+using index_type_for = typename std::conditional<
+    (Count < 0xFFFFu), std::uint16_t,
+    typename std::conditional<(Count < 0xFFFFFFFFu), std::uint32_t, std::size_t>::type>::type;
+
+/**
+ * @brief Compile-time sequence of indices, as std::index_sequence, which C++11 lacks. It unpacks the tuples of arguments of a
+ * piecewise construction.
+ */
+template <std::size_t... I>
+struct index_sequence {};
+
+template <std::size_t N, std::size_t... I>
+struct make_index_sequence_impl : make_index_sequence_impl<N - 1, N - 1, I...> {};
+
+template <std::size_t... I>
+struct make_index_sequence_impl<0, I...> {
+    using type = index_sequence<I...>;
+};
+
+template <std::size_t N>
+using make_index_sequence = typename make_index_sequence_impl<N>::type;
+
+}  // namespace detail
+}  // namespace bjg
+
+#endif
@@ -0,0 +1,450 @@
+#ifndef BJG_INTRUSIVE_LRU_CACHE_HPP
+#define BJG_INTRUSIVE_LRU_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "bjg/detail/errors.hpp"
+#include "bjg/detail/flat_index.hpp"
+#include "bjg/detail/preallocate.hpp"
+#include "bjg/detail/type_traits.hpp"
+
+namespace bjg {
+
+template <class T, class Key, class KeyOf, class Hash, class KeyEqual, class Allocator>
+class intrusive_lru_cache;
+
+/**
+ * @brief Base class of the objects linked by an intrusive_lru_cache. It holds the recency links of the object and the hash
+ * of its key. Copying an object does not copy its links: the copy is not linked.
+ */
+class lru_hook {
+   public:
+    lru_hook() noexcept = default;
+
+    lru_hook(const lru_hook & /*other*/) noexcept {}
+
+    lru_hook &operator=(const lru_hook & /*other*/) noexcept { return *this; }
+
+    /**
+     * @brief Checks if the object is linked in a cache.
+     */
+    bool is_linked() const noexcept { return linked_; }
+
+   protected:
+    ~lru_hook() = default;
+
+   private:
+    template <class T, class Key, class KeyOf, class Hash, class KeyEqual, class Allocator>
+    friend class intrusive_lru_cache;
+
+    lru_hook *prev_{nullptr};
+    lru_hook *next_{nullptr};
+    std::size_t hash_{0};
+    bool linked_{false};
+};
+
+/**
+ * @brief Least Recently Used (LRU) cache of objects owned elsewhere. The objects derive from lru_hook, which holds their
+ * recency links and the hash of their key, so the cache only links and unlinks them: it never copies, moves nor destroys an
+ * object. Evicting, erasing or replacing an object only unlinks it, and the object which leaves the cache is returned to the
+ * caller.
+ *
+ * The objects are indexed by their addresses in a flat index, whose buckets are the only memory of the cache. With the
+ * preallocate constructor, they are allocated up front, so linking objects never allocates.
+ *
+ * An object can only be linked in one cache at a time and must stay alive, with the same key, while it is linked. When both
+ * @p Hash and @p KeyEqual are transparent, the lookups also accept any key type they support.
+ *
+ * @tparam T The type of the objects, deriving from lru_hook.
+ * @tparam Key The key which uniquely identifies an object of the cache.
+ * @tparam KeyOf Returns the key of an object.
+ * @tparam Hash The hash function of the keys.
+ * @tparam KeyEqual The equality function of the keys.
+ * @tparam Allocator An allocator rebound to allocate the buckets of the index. It must use raw pointers.
+ */
+template <class T, class Key, class KeyOf, class Hash = std::hash<Key>, class KeyEqual = std::equal_to<Key>,
+          class Allocator = std::allocator<T *>>
+class intrusive_lru_cache {
+    static_assert(std::is_base_of<lru_hook, T>::value, "The cached objects must derive from lru_hook");
+
+   public:
+    using value_type = T;
+    using key_type = Key;
+    using hasher = Hash;
+    using key_equal = KeyEqual;
+    using allocator_type = Allocator;
+
+    /**
+     * @brief Creates a new lru cache with a limited capacity.
+     *
+     * @param capacity The maximum number of linked objects. Once this limit is reached, least recent objects are unlinked.
+     * @param key_of Returns the key of an object.
+     * @param hash The hash function of the keys.
+     * @param equal The equality function of the keys.
+     * @param alloc The allocator of the index.
+     *
+     * @throws std::length_error if the capacity is zero.
+     */
+    explicit intrusive_lru_cache(const std::size_t capacity, const KeyOf &key_of = KeyOf(), const Hash &hash = Hash(),
+                                 const KeyEqual &equal = KeyEqual(), const Allocator &alloc = Allocator())
+        : capacity_{checked_capacity(capacity)},
+          key_of_(key_of),
+          hash_(hash),
+          equal_(equal),
+          keys_{typename keys_type::allocator_type(alloc)} {}
+
+    /**
+     * @brief Creates a new lru cache with a limited capacity and allocates its index up front. Afterwards, linking and
+     * unlinking objects never allocates memory.
+     *
+     * @param capacity The maximum number of linked objects. Once this limit is reached, least recent objects are unlinked.
+     * @param key_of Returns the key of an object.
+     * @param hash The hash function of the keys.
+     * @param equal The equality function of the keys.
+     * @param alloc The allocator of the index.
+     *
+     * @throws std::length_error if the capacity is zero.
+     */
+    intrusive_lru_cache(const std::size_t capacity, preallocate_t, const KeyOf &key_of = KeyOf(), const Hash &hash = Hash(),
+                        const KeyEqual &equal = KeyEqual(), const Allocator &alloc = Allocator())
+        : intrusive_lru_cache{capacity, key_of, hash, equal, alloc} {
+        keys_.reserve(capacity_ + 1, stored_hash{});
+    }
+
+    intrusive_lru_cache(const intrusive_lru_cache &) = delete;
+    intrusive_lru_cache &operator=(const intrusive_lru_cache &) = delete;
+
+    /**
+     * @brief Takes the objects linked in another cache, which is left empty.
+     */
+    intrusive_lru_cache(intrusive_lru_cache &&other) noexcept
+        : capacity_{other.capacity_},
+          key_of_(std::move(other.key_of_)),
+          hash_(std::move(other.hash_)),
+          equal_(std::move(other.equal_)),
+          keys_(std::move(other.keys_)) {
+        take_links(other);
+    }
+
+    /**
+     * @brief Unlinks the objects of this cache and takes the objects linked in another cache, which is left empty.
+     */
+    intrusive_lru_cache &operator=(intrusive_lru_cache &&other) noexcept(
+        std::is_nothrow_move_assignable<keys_type>::value) {
+        if (this != &other) {
+            clear();
+            keys_ = std::move(other.keys_);
+            capacity_ = other.capacity_;
+            key_of_ = std::move(other.key_of_);
+            hash_ = std::move(other.hash_);
+            equal_ = std::move(other.equal_);
+            take_links(other);
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Unlinks all the objects.
+     */
+    ~intrusive_lru_cache() { unlink_all(); }
+
+    /**
+     * @brief Checks if the lru cache has no linked objects.
+     */
+    bool empty() const noexcept { return size_ == 0; }
+
+    /**
+     * @brief Returns the number of linked objects.
+     */
+    std::size_t size() const noexcept { return size_; }
+
+    allocator_type get_allocator() const noexcept { return allocator_type(keys_.get_allocator()); }
+
+    /**
+     * @brief Unlinks all the objects. The cache keeps its index.
+     */
+    void clear() noexcept {
+        unlink_all();
+        keys_.clear();
+    }
+
+    /**
+     * @brief Links an object as the most recent one. If an object with the same key is linked, it is replaced. If the
+     * capacity is exceeded, the least recent object is unlinked. If the object is already linked in this cache, it is only
+     * marked as the most recent one.
+     *
+     * @param object The object to link. It must not be linked in another cache.
+     *
+     * @return The object which left the cache, either replaced or evicted, or nullptr.
+     */
+    T *put(T &object) {
+        const auto &key = key_of_(object);
+        const auto hash = detail::mix_hash(hash_(key));
+        const auto position = keys_.find_or_prepare_insert(key, hash, object_matches<Key>{this, key, hash});
+        lru_hook &hook = object;
+        if (position.slot != keys_type::no_slot) {
+            lru_hook *const linked = hook_of(position.slot);
+            if (linked == &hook) {
+                move_to_front(hook);
+                return nullptr;
+            }
+
+            keys_.replace(hash, position.slot, slot_of(hook));
+            unlink(*linked);
+            link_front(hook, hash);
+            return static_cast<T *>(linked);
+        }
+
+        keys_.insert_at(position.bucket, key, hash, slot_of(hook), stored_hash{});
+        link_front(hook, hash);
+        return restrict_capacity();
+    }
+
+    /**
+     * @brief Returns an existing object and mark it as the most recent one.
+     *
+     * @param key The key of the existing object.
+     *
+     * @return The object with the given key.
+     * @throws std::out_of_range if the key does not exist.
+     */
+    T &get(const Key &key) { return checked_object(try_get(key)); }
+
+    /**
+     * @brief Transparent overload of get, looking up a key of any type supported by Hash and KeyEqual.
+     */
+    template <class K, class = detail::enable_if_transparent<Hash, KeyEqual, K>>
+    T &get(const K &key) {
+        return checked_object(try_get(key));
+    }
+
+    /**
+     * @brief Returns an object, if it exists, and marks it as the most recent one.
+     *
+     * @param key The key of the object.
+     *
+     * @return A pointer to the object with the given key or nullptr if the key does not exist.
+     */
+    T *try_get(const Key &key) { return promote(find_object(key)); }
+
+    /**
+     * @brief Transparent overload of try_get, looking up a key of any type supported by Hash and KeyEqual.
+     */
+    template <class K, class = detail::enable_if_transparent<Hash, KeyEqual, K>>
+    T *try_get(const K &key) {
+        return promote(find_object(key));
+    }
+
+    /**
+     * @brief Returns an object, if it exists, without marking it as the most recent one.
+     *
+     * @param key The key of the object.
+     *
+     * @return A pointer to the object with the given key or nullptr if the key does not exist.
+     */
+    const T *peek(const Key &key) const { return find_object(key); }
+
+    /**
+     * @brief Transparent overload of peek, looking up a key of any type supported by Hash and KeyEqual.
+     */
+    template <class K, class = detail::enable_if_transparent<Hash, KeyEqual, K>>
+    const T *peek(const K &key) const {
+        return find_object(key);
+    }
+
+    /**
+     * @brief Checks if the lru cache contains an object with the given key.
+     *
+     * @param key The key to check.
+     *
+     * @return true if the key exists, false otherwise.
+     */
+    bool contains(const Key &key) const { return find_object(key) != nullptr; }
+
+    /**
+     * @brief Transparent overload of contains, looking up a key of any type supported by Hash and KeyEqual.
+     */
+    template <class K, class = detail::enable_if_transparent<Hash, KeyEqual, K>>
+    bool contains(const K &key) const {
+        return find_object(key) != nullptr;
+    }
+
+    /**
+     * @brief Unlinks the object with the given key, if it exists.
+     *
+     * @param key The key of the object to unlink.
+     *
+     * @return The unlinked object or nullptr if the key does not exist.
+     */
+    T *erase(const Key &key) { return erase_object(find_object(key)); }
+
+    /**
+     * @brief Transparent overload of erase, looking up a key of any type supported by Hash and KeyEqual.
+     */
+    template <class K, class = detail::enable_if_transparent<Hash, KeyEqual, K>>
+    T *erase(const K &key) {
+        return erase_object(find_object(key));
+    }
+
+    /**
+     * @brief Unlinks an object of this cache, using its stored hash, e.g. before its owner destroys it.
+     *
+     * @param object The object to unlink, linked in this cache.
+     */
+    void erase(T &object) noexcept { erase_object(&object); }
+
+   private:
+    using keys_type = detail::flat_index<std::uintptr_t,
+                                         typename std::allocator_traits<Allocator>::template rebind_alloc<std::uintptr_t>>;
+
+    /**
+     * @brief Returns the hash stored in the hook of an indexed object.
+     */
+    struct stored_hash {
+        std::size_t operator()(const std::uintptr_t slot) const noexcept { return hook_of(slot)->hash_; }
+    };
+
+    /**
+     * @brief Checks if an indexed object has the searched key. The stored hashes are compared before the keys.
+     */
+    template <class K>
+    struct object_matches {
+        const intrusive_lru_cache *cache;
+        const K &key;
+        std::size_t hash;
+
+        bool operator()(const std::uintptr_t slot) const {
+            const lru_hook *const hook = hook_of(slot);
+            return hook->hash_ == hash && cache->equal_(cache->key_of_(*static_cast<const T *>(hook)), key);
+        }
+    };
+
+    static std::size_t checked_capacity(const std::size_t capacity) {
+        if (capacity == 0) {
+            detail::throw_length_error("Cache capacity must be greater than zero");
+        }
+
+        return capacity;
+    }
+
+    static T &checked_object(T *object) {
+        if (object == nullptr) {
+            detail::throw_out_of_range("Key not found");
+        }
+
+        return *object;
+    }
+
+    static std::uintptr_t slot_of(lru_hook &hook) noexcept { return reinterpret_cast<std::uintptr_t>(&hook); }
+
+    static lru_hook *hook_of(const std::uintptr_t slot) noexcept { return reinterpret_cast<lru_hook *>(slot); }
+
+    template <class K>
+    T *find_object(const K &key) const {
+        const auto hash = detail::mix_hash(hash_(key));
+        const auto slot = keys_.find(key, hash, object_matches<K>{this, key, hash});
+        return slot == keys_type::no_slot ? nullptr : static_cast<T *>(hook_of(slot));
+    }
+
+    T *promote(T *object) noexcept {
+        if (object != nullptr) move_to_front(*object);
+        return object;
+    }
+
+    T *erase_object(T *object) noexcept {
+        if (object == nullptr) return nullptr;
+
+        lru_hook &hook = *object;
+        keys_.erase(key_of_(*object), hook.hash_, slot_of(hook));
+        unlink(hook);
+        return object;
+    }
+
+    /**
+     * @brief Unlinks the least recent object if the capacity is exceeded.
+     *
+     * @return The unlinked object or nullptr.
+     */
+    T *restrict_capacity() noexcept {
+        return size_ > capacity_ ? erase_object(static_cast<T *>(tail_)) : nullptr;
+    }
+
+    void link_front(lru_hook &hook, const std::size_t hash) noexcept {
+        hook.hash_ = hash;
+        hook.linked_ = true;
+        hook.prev_ = nullptr;
+        hook.next_ = head_;
+        if (head_ != nullptr) {
+            head_->prev_ = &hook;
+        } else {
+            tail_ = &hook;
+        }
+        head_ = &hook;
+        ++size_;
+    }
+
+    void unlink(lru_hook &hook) noexcept {
+        if (hook.prev_ != nullptr) {
+            hook.prev_->next_ = hook.next_;
+        } else {
+            head_ = hook.next_;
+        }
+        if (hook.next_ != nullptr) {
+            hook.next_->prev_ = hook.prev_;
+        } else {
+            tail_ = hook.prev_;
+        }
+        hook.prev_ = nullptr;
+        hook.next_ = nullptr;
+        hook.linked_ = false;
+        --size_;
+    }
+
+    void move_to_front(lru_hook &hook) noexcept {
+        if (&hook == head_) return;
+
+        const auto hash = hook.hash_;
+        unlink(hook);
+        link_front(hook, hash);
+    }
+
+    void unlink_all() noexcept {
+        for (lru_hook *hook = head_; hook != nullptr;) {
+            lru_hook *const next = hook->next_;
+            hook->prev_ = nullptr;
+            hook->next_ = nullptr;
+            hook->linked_ = false;
+            hook = next;
+        }
+        head_ = nullptr;
+        tail_ = nullptr;
+        size_ = 0;
+    }
+
+    void take_links(intrusive_lru_cache &other) noexcept {
+        head_ = other.head_;
+        tail_ = other.tail_;
+        size_ = other.size_;
+        other.head_ = nullptr;
+        other.tail_ = nullptr;
+        other.size_ = 0;
+    }
+
+    std::size_t capacity_;
+    KeyOf key_of_;
+    Hash hash_;
+    KeyEqual equal_;
+    keys_type keys_;
+    lru_hook *head_{nullptr};
+    lru_hook *tail_{nullptr};
+    std::size_t size_{0};
+};
+
+}  // namespace bjg
+
+#endif
@@ -1,209 +1,394 @@
 #ifndef BJG_LRU_CACHE_HPP
 #define BJG_LRU_CACHE_HPP
 
-#include <list>
-#include <stdexcept>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
 #include <type_traits>
-#include <unordered_map>
 #include <utility>
 
+#include "bjg/detail/errors.hpp"
+#include "bjg/detail/flat_index.hpp"
+#include "bjg/detail/integer_index.hpp"
+#include "bjg/detail/lru_cache_base.hpp"
+#include "bjg/detail/lru_slab.hpp"
+#include "bjg/detail/preallocate.hpp"
+#include "bjg/detail/type_traits.hpp"
+
+#if defined(_MSVC_LANG)
+#define BJG_LRU_CACHE_CPLUSPLUS _MSVC_LANG
+#else
+#define BJG_LRU_CACHE_CPLUSPLUS __cplusplus
+#endif
+
+#if BJG_LRU_CACHE_CPLUSPLUS >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define BJG_LRU_CACHE_HAVE_PMR
+#endif
+#endif
+
 namespace bjg {
 
 /**
- * @brief Least Recently Used (LRU) cache container with a fixed capacity. After the maximum capacity is reached, least recently
- * used items are evicted from the cache.
+ * @brief Errors reported by the lru cache factory, which does not throw.
+ */
+enum class cache_errc {
+    /**
+     * @brief The capacity is zero or greater than the maximum capacity of the cache.
+     */
+    invalid_capacity = 1,
+
+    /**
+     * @brief The allocator returned nullptr for the storage of the cache.
+     */
+    out_of_memory
+};
+
+/**
+ * @brief Outcome of a cache factory: either the created cache or the error which prevented its creation.
  *
- * @tparam Key The key which uniquely identifies an item from the lru cache.
- * @tparam Value The value associated to the @p Key.
+ * @tparam Cache The type of the created cache.
  */
-template <class Key, class Value>
-class lru_cache {
+template <class Cache>
+class create_result {
+    friend Cache;
+
    public:
-    using item_type = std::pair<const Key, Value>;
-    using items_list = std::list<item_type>;
-    using items_list_iterator = typename items_list::iterator;
+    create_result(create_result &&other) noexcept(std::is_nothrow_move_constructible<Cache>::value) : error_{other.error_} {
+        if (*this) ::new (static_cast<void *>(&cache_)) Cache(std::move(other.cache_));
+    }
+
+    create_result(const create_result &) = delete;
+    create_result &operator=(const create_result &) = delete;
+    create_result &operator=(create_result &&) = delete;
+
+    ~create_result() {
+        if (*this) cache_.~Cache();
+    }
 
     /**
-     * @brief Creates a new lru cache with a limited capacity.
-     *
-     * @param capacity The maximum capacity of the cache. Once this limit is reached, least recent items are evicted.
-     *
-     * @throws std::length_error if the capacity is zero.
+     * @brief Checks if the cache was created.
      */
-    explicit lru_cache(const std::size_t capacity) : capacity_{capacity} {
-        if (capacity_ == 0) {
-            throw std::length_error{"Cache capacity must be greater than zero"};
-        }
-    }
+    explicit operator bool() const noexcept { return error_ == cache_errc{}; }
 
     /**
-     * @brief Checks if the lru cache has no items.
-     *
-     * @return true if the lru cache is empty, false otherwise.
+     * @brief Returns the error which prevented the creation of the cache, unspecified if the cache was created.
      */
-    bool empty() const noexcept { return keys_.empty(); }
+    cache_errc error() const noexcept { return error_; }
 
     /**
-     * @brief Returns the number of items in the lru cache.
+     * @brief Returns the created cache, which can be moved out.
      *
-     * @return The number of items.
+     * @pre The cache must have been created.
      */
-    std::size_t size() const noexcept { return keys_.size(); }
+    Cache &operator*() noexcept { return cache_; }
 
+    const Cache &operator*() const noexcept { return cache_; }
+
+    Cache *operator->() noexcept { return &cache_; }
+
+    const Cache *operator->() const noexcept { return &cache_; }
+
+   private:
     /**
-     * @brief Remove all items from the lru cache.
+     * @brief Holds an error. Only the factory of the cache can build a result, so no result holds the success value without
+     * a cache.
      */
-    void clear() noexcept {
-        keys_.clear();
-        items_.clear();
+    create_result(const cache_errc error) noexcept : error_{error} {}
+
+    create_result(Cache &&cache) noexcept(std::is_nothrow_move_constructible<Cache>::value) : error_{} {
+        ::new (static_cast<void *>(&cache_)) Cache(std::move(cache));
     }
 
-    /**
-     * @brief Adds an item to the lru cache or update the existing item's value and mark it as the most recent one if the key
-     * already exists.
-     *
-     * @param item The item to insert.
-     */
-    void put(const item_type &item) {
-        if (contains(item.first)) {
-            move_to_front(item.first);
-            update_front_value(item.second);
-        } else {
-            insert_new_item(item);
-        }
+    cache_errc error_;
+    union {
+        Cache cache_;
+    };
+};
+
+/**
+ * @brief Allocator which returns nullptr when the memory is exhausted instead of throwing std::bad_alloc. The lru cache
+ * factory reports such failures as cache_errc::out_of_memory; any other failed allocation raises std::bad_alloc, or aborts
+ * in a build without exceptions.
+ */
+template <class T>
+struct nothrow_allocator {
+    using value_type = T;
+
+    nothrow_allocator() noexcept = default;
+    template <class U>
+    nothrow_allocator(const nothrow_allocator<U> & /*other*/) noexcept {}
+
+    T *allocate(const std::size_t count) noexcept {
+        if (count > static_cast<std::size_t>(-1) / sizeof(T)) return nullptr;
+        return static_cast<T *>(::operator new(count * sizeof(T), std::nothrow));
     }
 
+    void deallocate(T *pointer, std::size_t /*count*/) noexcept { ::operator delete(pointer); }
+
+    template <class U>
+    bool operator==(const nothrow_allocator<U> & /*other*/) const noexcept {
+        return true;
+    }
+    template <class U>
+    bool operator!=(const nothrow_allocator<U> & /*other*/) const noexcept {
+        return false;
+    }
+};
+
+/**
+ * @brief Layout of a lru cache storing each value next to its key, in the same node.
+ */
+struct packed_layout {};
+
+/**
+ * @brief Layout of a lru cache storing the keys, their hashes and the recency links in one dense array and the values in a
+ * parallel one, so that lookups and evictions do not load the values.
+ */
+struct split_layout {};
+
+namespace detail {
+
+/**
+ * @brief Checks if the keys of a lru cache are integers hashed and compared by the standard functions, which are stored
+ * inline in its keys index and never hashed.
+ */
+template <class Key, class Hash, class KeyEqual>
+struct has_integer_keys
+    : std::integral_constant<bool, std::is_integral<Key>::value && std::is_same<Hash, std::hash<Key>>::value &&
+                                       std::is_same<KeyEqual, std::equal_to<Key>>::value> {};
+
+/**
+ * @brief Selects the slab of the items of a lru cache from its @p Layout. The stored keys are not const, so a full cache can
+ * assign a new key to its least recent item. The nodes have generations when the lru cache has @p Handles, and keep the
+ * hashes of their items unless they have integer keys.
+ */
+template <class Layout, class Key, class Value, class Allocator, class Index, bool Handles, bool Hashes>
+struct heap_items;
+
+template <class Key, class Value, class Allocator, class Index, bool Handles, bool Hashes>
+struct heap_items<packed_layout, Key, Value, Allocator, Index, Handles, Hashes> {
+    using type = lru_slab<std::pair<Key, Value>, Allocator, Index, Handles, Hashes>;
+};
+
+template <class Key, class Value, class Allocator, class Index, bool Handles, bool Hashes>
+struct heap_items<split_layout, Key, Value, Allocator, Index, Handles, Hashes> {
+    using type = split_lru_slab<Key, Value, Allocator, Index, Handles, Hashes>;
+};
+
+/**
+ * @brief Selects the keys index of a lru cache: integer keys are stored inline in an integer_index, any other keys are
+ * compared through a flat_index of their slots.
+ */
+template <class Key, class Hash, class KeyEqual, class Allocator, class Index>
+using heap_keys = typename std::conditional<
+    has_integer_keys<Key, Hash, KeyEqual>::value,
+    integer_index<Key, Index, typename std::allocator_traits<Allocator>::template rebind_alloc<Index>>,
+    flat_index<Index, typename std::allocator_traits<Allocator>::template rebind_alloc<Index>>>::type;
+
+/**
+ * @brief Base of the lru cache allocating its storage on the heap through @p Allocator, linking its items with @p Index and
+ * laying them out as selected by @p Layout.
+ */
+template <class Key, class Value, class Hash, class KeyEqual, class Allocator, class Index, class Layout, bool Handles>
+using heap_lru_cache_base =
+    lru_cache_base<Key, Value, Hash, KeyEqual,
+                   typename heap_items<Layout, Key, Value, Allocator, Index, Handles,
+                                       !has_integer_keys<Key, Hash, KeyEqual>::value>::type,
+                   heap_keys<Key, Hash, KeyEqual, Allocator, Index>>;
+
+/**
+ * @brief Selects the links of a cache holding up to @p MaxCapacity items, plus the spare node of its slab.
+ */
+template <std::size_t MaxCapacity>
+using capacity_index_type = index_type_for<MaxCapacity == static_cast<std::size_t>(-1) ? MaxCapacity : MaxCapacity + 1>;
+
+}  // namespace detail
+
+/**
+ * @brief Least Recently Used (LRU) cache container with a fixed capacity. After the maximum capacity is reached, least recently
+ * used items are evicted from the cache.
+ *
+ * Items are kept in a single contiguous slab which grows up to the cache capacity, so once the cache is full no further
+ * allocation takes place for the items. References returned by the cache are invalidated by the next insertion. See
+ * detail::lru_cache_base for the operations.
+ *
+ * Both the slab and the keys index allocate their memory through @p Allocator, and the items are constructed through it, so
+ * scoped allocators such as the polymorphic ones propagate to the keys and values.
+ *
+ * When @p MaxCapacity bounds the capacity below 65534 or 2^32 - 2, the slab links and the index slots are 16 or 32 bit
+ * integers and the slab stores 32 bit hashes, which shrinks the metadata of an item from 33 to 11 or 17 bytes. See
+ * compact_lru_cache.
+ *
+ * With @p Handles, put and find return handles which reach the items again without hashing their keys. Each item then keeps
+ * a 32 bit generation, which adds 4 bytes to its metadata. See handle_lru_cache.
+ *
+ * Integer keys hashed and compared by std::hash and std::equal_to are stored inline in the keys index too, next to their
+ * slots, so looking them up never reads the items. They are placed by a multiply-shift hash in a linear probing table, whose
+ * buckets are tagged with epochs so that clear takes constant time.
+ *
+ * With split_layout, the values are stored apart from the keys, hashes and links, which keeps probing and evicting cache
+ * friendly when the values are large. See split_lru_cache.
+ *
+ * @tparam Key The key which uniquely identifies an item from the lru cache.
+ * @tparam Value The value associated to the @p Key.
+ * @tparam Hash The hash function of the keys.
+ * @tparam KeyEqual The equality function of the keys.
+ * @tparam Allocator The allocator of the items, rebound for the slab nodes and the index buckets. It must use raw pointers.
+ * @tparam MaxCapacity The maximum capacity a cache of this type can be created with.
+ * @tparam Layout How the items are laid out in memory, packed_layout or split_layout.
+ * @tparam Handles Whether put and find return handles to the items.
+ */
+template <class Key, class Value, class Hash = std::hash<Key>, class KeyEqual = std::equal_to<Key>,
+          class Allocator = std::allocator<std::pair<const Key, Value>>,
+          std::size_t MaxCapacity = static_cast<std::size_t>(-1), class Layout = packed_layout, bool Handles = false>
+class lru_cache : public detail::heap_lru_cache_base<Key, Value, Hash, KeyEqual, Allocator,
+                                                     detail::capacity_index_type<MaxCapacity>, Layout, Handles> {
+    using base = detail::heap_lru_cache_base<Key, Value, Hash, KeyEqual, Allocator,
+                                             detail::capacity_index_type<MaxCapacity>, Layout, Handles>;
+
+   public:
+    using allocator_type = Allocator;
+
     /**
-     * @brief Returns the value of an existing item and mark the item as the most recent one.
+     * @brief Creates a new lru cache with a limited capacity.
      *
-     * @param key The key of the existing item.
+     * @param capacity The maximum capacity of the cache. Once this limit is reached, least recent items are evicted. A
+     * capacity which the links cannot address, such as SIZE_MAX for an unbounded cache, is lowered to the largest one they can.
+     * @param hash The hash function of the keys.
+     * @param equal The equality function of the keys.
+     * @param alloc The allocator of the cache's storage.
      *
-     * @return The value associated to the given key.
-     * @throws std::out_of_range if the key does not exist.
+     * @throws std::length_error if the capacity is zero or greater than MaxCapacity.
      */
-    const Value &get(const Key &key) {
-        if (!contains(key)) {
-            throw std::out_of_range{"Key not found"};
-        }
+    explicit lru_cache(const std::size_t capacity, const Hash &hash = Hash(), const KeyEqual &equal = KeyEqual(),
+                       const Allocator &alloc = Allocator())
+        : base{checked_capacity(capacity), hash, equal,
+               typename base::items_list{static_cast<typename base::items_list_index>(clamped_capacity(capacity) + 1), alloc},
+               typename base::keys_type{typename base::keys_type::allocator_type(alloc)}} {}
 
-        move_to_front(key);
-        return get_front_value();
-    }
+    lru_cache(const std::size_t capacity, const Allocator &alloc) : lru_cache{capacity, Hash(), KeyEqual(), alloc} {}
 
     /**
-     * @brief Checks if the lru cache contains an item with the given key.
+     * @brief Creates a new lru cache with a limited capacity and allocates the storage for all its items and their index up
+     * front. Afterwards, put, get and the evictions never allocate memory for the cache itself.
      *
-     * @param key The key to check.
+     * @param capacity The maximum capacity of the cache. Once this limit is reached, least recent items are evicted.
+     * @param hash The hash function of the keys.
+     * @param equal The equality function of the keys.
+     * @param alloc The allocator of the cache's storage.
      *
-     * @return true if the key exists, false otherwise.
+     * @throws std::length_error if the capacity is zero or greater than MaxCapacity.
      */
-    bool contains(const Key &key) const { return keys_.find(key) != keys_.cend(); }
+    lru_cache(const std::size_t capacity, preallocate_t, const Hash &hash = Hash(), const KeyEqual &equal = KeyEqual(),
+              const Allocator &alloc = Allocator())
+        : lru_cache{capacity, hash, equal, alloc} {
+        this->items_.reserve(this->capacity_ + 1);
+        this->keys_.reserve(this->capacity_ + 1, typename base::stored_hash{&this->items_});
+    }
+
+    lru_cache(const std::size_t capacity, preallocate_t, const Allocator &alloc)
+        : lru_cache{capacity, preallocate, Hash(), KeyEqual(), alloc} {}
 
-   private:
     /**
-     * This is a simpler version for the GuardedScope mechanism presented here:
-     * https://www.drdobbs.com/cpp/generic-change-the-way-you-write-excepti/184403758 If you already have a pattern/mechanism in
-     * your project for handling this situation, please consider adapting the lru_cache according to your project and drop this
-     * one.
+     * @brief Creates a new lru cache and allocates its storage up front, as the preallocating constructor does, but reports
+     * its errors instead of throwing them, so it can be used in a build without exceptions. An allocation failure is only
+     * reported if the allocator returns nullptr, as nothrow_allocator does.
+     *
+     * @param capacity The maximum capacity of the cache. Once this limit is reached, least recent items are evicted.
+     * @param hash The hash function of the keys.
+     * @param equal The equality function of the keys.
+     * @param alloc The allocator of the cache's storage.
      *
-     * @tparam F The type of the function to be called on scope exit. This function must not throw.
+     * @return The lru cache, or cache_errc::invalid_capacity if the capacity is zero, greater than MaxCapacity or too large
+     * for its storage to be addressed, e.g. SIZE_MAX, or cache_errc::out_of_memory if its storage cannot be allocated.
      */
-    template <typename F>
-    class guarded_scope {
-       public:
-        explicit guarded_scope(F &&f) noexcept : f_(std::move(f)), dismiss_{false} {}
-
-        ~guarded_scope() noexcept {
-            if (!dismiss_) f_();
+    static create_result<lru_cache> create(const std::size_t capacity, const Hash &hash = Hash(),
+                                           const KeyEqual &equal = KeyEqual(), const Allocator &alloc = Allocator()) {
+        if (capacity == 0 || capacity > MaxCapacity || capacity > addressable_capacity()) {
+            return cache_errc::invalid_capacity;
         }
 
-        void dismiss() noexcept { dismiss_ = true; }
-
-       private:
-        F f_;
-        bool dismiss_;
-    };
+        lru_cache cache{capacity, hash, equal, alloc};
+        if (!cache.items_.try_reserve(capacity + 1) ||
+            !cache.keys_.try_reserve(capacity + 1, typename base::stored_hash{&cache.items_})) {
+            return cache_errc::out_of_memory;
+        }
+        return create_result<lru_cache>{std::move(cache)};
+    }
 
-    /**
-     * @brief Calls a function and reverts its behavior if the call fails.
-     *
-     * @param f The function to call.
-     * @param r The function which reverts f's behavior.
-     */
-    template <typename F, typename R>
-    void guarded_call(F &&f, R &&r) {
-        auto guard = guarded_scope<R>(std::forward<R>(r));
-        f();
-        guard.dismiss();
+    static create_result<lru_cache> create(const std::size_t capacity, const Allocator &alloc) {
+        return create(capacity, Hash(), KeyEqual(), alloc);
     }
 
     /**
-     * @brief Evicts the least recent item if the lru cache size exceeds the maximum capacity.
+     * @brief Returns the allocator of the lru cache.
      */
-    void restrict_capacity() {
-        if (items_.size() > capacity_) {
-            keys_.erase(items_.back().first);
-            items_.pop_back();  // never throws as capacity is always > 0 and items_.size() > capacity
+    allocator_type get_allocator() const noexcept { return this->items_.get_allocator(); }
+
+   private:
+    static std::size_t checked_capacity(const std::size_t capacity) {
+        if (capacity > MaxCapacity) {
+            detail::throw_length_error("Cache capacity exceeds the maximum capacity");
         }
-    }
 
-    /**
-     * @brief Inserts an item as the most recent one to the lru cache.
-     *
-     * @param item The item to insert.
-     */
-    void insert_new_item(const item_type &item) {
-        auto emplaced_item = std::make_pair(keys_.end(), false);
-        items_.push_front(item);
-        guarded_call([this, &item, &emplaced_item]() { emplaced_item = keys_.emplace(item.first, items_.begin()); },
-                     [this]() { items_.pop_front(); });
-        guarded_call([this]() { restrict_capacity(); },
-                     [this, &emplaced_item]() {
-                         // If the code execution reaches this point, emplaced_item contains a valid iterator
-                         keys_.erase(emplaced_item.first);
-                         items_.pop_front();
-                     });
+        return clamped_capacity(capacity);
     }
 
     /**
-     * @brief Marks an item as the most recent one.
-     *
-     * @param key The key of the item to mark.
-     * @pre @p key must exist in @p items_
+     * @brief Returns the largest capacity whose items, plus the spare node of the slab, are addressed below npos.
      */
-    void move_to_front(const Key &key) {
-        const auto existing_item = keys_.find(key);
-        if (existing_item->second == items_.begin()) return;
-
-        const auto next_it = std::next(existing_item->second);
-        items_.splice(items_.begin(), items_, existing_item->second, next_it);
-        guarded_call([this, &existing_item]() { auto it_copy = items_.begin(); std::swap(existing_item->second, it_copy); },
-                     [this, &next_it]() { items_.splice(next_it, items_, items_.begin(), std::next(items_.begin())); });
+    static constexpr std::size_t addressable_capacity() noexcept {
+        return static_cast<std::size_t>(base::items_list::npos) - 2;
     }
 
     /**
-     * @brief Updates the value of the most recent used item.
-     *
-     * @param value The new value.
+     * @brief Lowers a capacity to the addressable capacity, so that the slab limit, one node more, does not wrap around.
      */
-    void update_front_value(const Value &value) noexcept(std::is_nothrow_copy_assignable<Value>()) {
-        auto value_copy = value;
-        std::swap(items_.front().second, value_copy);
+    static constexpr std::size_t clamped_capacity(const std::size_t capacity) noexcept {
+        return capacity < addressable_capacity() ? capacity : addressable_capacity();
     }
+};
 
-    /**
-     * @brief Returns the value of the most recent used item.
-     *
-     * @pre @p items_ must contain at least one item.
-     *
-     * @return The value of the most recent used item.
-     */
-    const Value &get_front_value() const noexcept { return items_.front().second; }
+/**
+ * @brief Lru cache whose capacity is bounded by @p MaxCapacity, so its items are linked and indexed by 16 bit integers when
+ * MaxCapacity is lower than 65534, and by 32 bit integers when it is lower than 2^32 - 2.
+ */
+template <class Key, class Value, std::size_t MaxCapacity, class Hash = std::hash<Key>, class KeyEqual = std::equal_to<Key>,
+          class Allocator = std::allocator<std::pair<const Key, Value>>>
+using compact_lru_cache = lru_cache<Key, Value, Hash, KeyEqual, Allocator, MaxCapacity>;
 
-    std::size_t capacity_;
-    items_list items_;
-    std::unordered_map<const Key, items_list_iterator, std::hash<Key>> keys_;
-};
+/**
+ * @brief Lru cache storing its values apart from the keys, hashes and links, so that lookups and evictions only walk dense
+ * metadata even when the values are large.
+ */
+template <class Key, class Value, class Hash = std::hash<Key>, class KeyEqual = std::equal_to<Key>,
+          class Allocator = std::allocator<std::pair<const Key, Value>>,
+          std::size_t MaxCapacity = static_cast<std::size_t>(-1)>
+using split_lru_cache = lru_cache<Key, Value, Hash, KeyEqual, Allocator, MaxCapacity, split_layout>;
+
+/**
+ * @brief Lru cache whose put and find return handles, which reach the items again without hashing their keys, at the cost
+ * of a 32 bit generation per item.
+ */
+template <class Key, class Value, class Hash = std::hash<Key>, class KeyEqual = std::equal_to<Key>,
+          class Allocator = std::allocator<std::pair<const Key, Value>>,
+          std::size_t MaxCapacity = static_cast<std::size_t>(-1), class Layout = packed_layout>
+using handle_lru_cache = lru_cache<Key, Value, Hash, KeyEqual, Allocator, MaxCapacity, Layout, true>;
+
+#ifdef BJG_LRU_CACHE_HAVE_PMR
+namespace pmr {
+
+/**
+ * @brief Lru cache whose storage is allocated from a std::pmr::memory_resource, given as the last constructor argument.
+ */
+template <class Key, class Value, class Hash = std::hash<Key>, class KeyEqual = std::equal_to<Key>>
+using lru_cache = bjg::lru_cache<Key, Value, Hash, KeyEqual, std::pmr::polymorphic_allocator<std::pair<const Key, Value>>>;
+
+}  // namespace pmr
+#endif
 }  // namespace bjg
 
 #endif
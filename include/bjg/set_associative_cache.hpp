@@ -0,0 +1,567 @@
+#ifndef BJG_SET_ASSOCIATIVE_CACHE_HPP
+#define BJG_SET_ASSOCIATIVE_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "bjg/detail/allocator_utils.hpp"
+#include "bjg/detail/errors.hpp"
+#include "bjg/detail/flat_index.hpp"
+#include "bjg/detail/guarded_scope.hpp"
+#include "bjg/detail/type_traits.hpp"
+
+namespace bjg {
+namespace detail {
+
+/**
+ * @brief Returns the smallest power of two greater than or equal to @p value.
+ */
+constexpr std::size_t next_power_of_two(const std::size_t value, const std::size_t power = 1) noexcept {
+    return power >= value ? power : next_power_of_two(value, power * 2);
+}
+
+}  // namespace detail
+
+/**
+ * @brief Cache with a fixed capacity, split into sets of @p Ways items. The hash of a key selects the only set where its item
+ * can live, and the least recently used item of that set is evicted when a new item enters a full set. The eviction order is
+ * thus an approximation of the LRU order of the whole cache, in exchange for a bounded work per operation: there is no global
+ * recency list, and a lookup reads the metadata of a single set, then the items whose tag matches.
+ *
+ * The metadata of a set fits in 16, 32 or 64 bytes, for 4, 8 or 16 ways, and is aligned on its size so it never straddles
+ * cache lines. It holds a 7 bit tag of the hash and a recency rank per slot, 0 being the most recent item of the set. Each
+ * set has one slot more than its ways, so a new item is constructed before the least recent one is evicted, which keeps put
+ * strongly exception safe.
+ *
+ * All the storage is allocated by the constructor, so put and get never allocate memory for the cache itself. References
+ * returned by the cache are invalidated when their item is evicted or erased.
+ *
+ * When both @p Hash and @p KeyEqual are transparent, get, try_get, peek, contains and erase also accept any key type they
+ * support.
+ *
+ * @tparam Key The key which uniquely identifies an item from the cache.
+ * @tparam Value The value associated to the @p Key.
+ * @tparam Ways The number of items of a set: 4, 8 or 16.
+ * @tparam Hash The hash function of the keys.
+ * @tparam KeyEqual The equality function of the keys.
+ * @tparam Allocator The allocator of the items, rebound for the metadata of the sets. It must use raw pointers.
+ */
+template <class Key, class Value, std::size_t Ways = 8, class Hash = std::hash<Key>, class KeyEqual = std::equal_to<Key>,
+          class Allocator = std::allocator<std::pair<const Key, Value>>>
+class set_associative_cache {
+    static_assert(Ways == 4 || Ways == 8 || Ways == 16, "A set holds 4, 8 or 16 ways");
+
+   public:
+    using item_type = std::pair<const Key, Value>;
+    using hasher = Hash;
+    using key_equal = KeyEqual;
+    using allocator_type = Allocator;
+
+    /**
+     * @brief The number of items of a set.
+     */
+    static constexpr std::size_t ways = Ways;
+
+    /**
+     * @brief Creates a new cache and allocates all its storage.
+     *
+     * @param capacity The minimum capacity of the cache. It is rounded up to a power of two number of sets.
+     * @param hash The hash function of the keys.
+     * @param equal The equality function of the keys.
+     * @param alloc The allocator of the cache's storage.
+     *
+     * @throws std::length_error if the capacity is zero or too large.
+     */
+    explicit set_associative_cache(const std::size_t capacity, const Hash &hash = Hash(), const KeyEqual &equal = KeyEqual(),
+                                   const Allocator &alloc = Allocator())
+        : hash_(hash), equal_(equal), alloc_(alloc), set_mask_{set_count_for(capacity) - 1} {
+        allocate_sets();
+    }
+
+    set_associative_cache(const std::size_t capacity, const Allocator &alloc)
+        : set_associative_cache{capacity, Hash(), KeyEqual(), alloc} {}
+
+    set_associative_cache(const set_associative_cache &other)
+        : set_associative_cache(other, traits::select_on_container_copy_construction(other.alloc_)) {}
+
+    set_associative_cache(const set_associative_cache &other, const Allocator &alloc)
+        : hash_(other.hash_), equal_(other.equal_), alloc_(alloc), set_mask_{other.set_mask_} {
+        clone_items(other, copy_source{});
+    }
+
+    /**
+     * @brief Takes the storage of another cache. The other cache is left empty, and allocates its storage again on its next
+     * insertion.
+     */
+    set_associative_cache(set_associative_cache &&other) noexcept(
+        std::is_nothrow_move_constructible<Hash>::value && std::is_nothrow_move_constructible<KeyEqual>::value)
+        : hash_(std::move(other.hash_)),
+          equal_(std::move(other.equal_)),
+          alloc_(std::move(other.alloc_)),
+          set_mask_{other.set_mask_} {
+        swap_storage(other);
+    }
+
+    set_associative_cache(set_associative_cache &&other, const Allocator &alloc)
+        : hash_(std::move(other.hash_)), equal_(std::move(other.equal_)), alloc_(alloc), set_mask_{other.set_mask_} {
+        if (alloc_ == other.alloc_) {
+            swap_storage(other);
+        } else {
+            clone_items(other, move_source{});
+        }
+    }
+
+    /**
+     * @brief Copies the items of another cache. If the copy fails, the cache is left unchanged.
+     */
+    set_associative_cache &operator=(const set_associative_cache &other) {
+        if (this != &other) {
+            set_associative_cache copy{other,
+                                       traits::propagate_on_container_copy_assignment::value ? other.alloc_ : alloc_};
+            swap_state(copy);
+            detail::swap_allocators(alloc_, copy.alloc_, typename traits::propagate_on_container_copy_assignment{});
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Moves the items of another cache. If the move fails, the cache is left unchanged.
+     */
+    set_associative_cache &operator=(set_associative_cache &&other) noexcept(
+        traits::propagate_on_container_move_assignment::value && detail::is_nothrow_swappable_by_move<Hash>::value &&
+        detail::is_nothrow_swappable_by_move<KeyEqual>::value) {
+        if (this != &other) {
+            set_associative_cache moved{std::move(other),
+                                        traits::propagate_on_container_move_assignment::value ? other.alloc_ : alloc_};
+            swap_state(moved);
+            detail::swap_allocators(alloc_, moved.alloc_, typename traits::propagate_on_container_move_assignment{});
+        }
+        return *this;
+    }
+
+    ~set_associative_cache() { release(); }
+
+    /**
+     * @brief Checks if the cache has no items.
+     */
+    bool empty() const noexcept { return size_ == 0; }
+
+    /**
+     * @brief Returns the number of items in the cache.
+     */
+    std::size_t size() const noexcept { return size_; }
+
+    /**
+     * @brief Returns the maximum number of items of the cache, which is the number of sets times the number of ways.
+     */
+    std::size_t capacity() const noexcept { return (set_mask_ + 1) * Ways; }
+
+    allocator_type get_allocator() const noexcept { return alloc_; }
+
+    /**
+     * @brief Remove all items from the cache. The cache keeps its storage.
+     */
+    void clear() noexcept {
+        if (sets_ == nullptr) return;
+
+        for (std::size_t set = 0; set <= set_mask_; ++set) {
+            for (std::size_t slot = 0; slot < slots; ++slot) {
+                if (sets_[set].tags[slot] != empty_tag) traits::destroy(alloc_, item_at(set, slot));
+            }
+            sets_[set] = set_meta();
+        }
+        size_ = 0;
+    }
+
+    /**
+     * @brief Adds an item to the cache or update the existing item's value and mark it as the most recent one of its set if
+     * the key already exists. Adding an item to a full set evicts the least recent item of that set.
+     *
+     * @param item The item to insert.
+     */
+    void put(const item_type &item) {
+        const auto where = locate(item.first);
+        const auto slot = find_slot(item.first, where);
+        if (slot != slots) {
+            auto value_copy = item.second;
+            std::swap(item_at(where.set, slot)->second, value_copy);
+            touch(sets_[where.set], slot);
+        } else {
+            insert_new_item(where, item);
+        }
+    }
+
+    /**
+     * @brief Returns the value of an existing item and mark the item as the most recent one of its set.
+     *
+     * @param key The key of the existing item.
+     *
+     * @return The value associated to the given key.
+     * @throws std::out_of_range if the key does not exist.
+     */
+    const Value &get(const Key &key) { return checked_value(try_get(key)); }
+
+    /**
+     * @brief Transparent overload of get, looking up a key of any type supported by Hash and KeyEqual.
+     */
+    template <class K, class = detail::enable_if_transparent<Hash, KeyEqual, K>>
+    const Value &get(const K &key) {
+        return checked_value(try_get(key));
+    }
+
+    /**
+     * @brief Returns the value of an item, if it exists, and marks the item as the most recent one of its set.
+     *
+     * @param key The key of the item.
+     *
+     * @return A pointer to the value associated to the given key or nullptr if the key does not exist.
+     */
+    const Value *try_get(const Key &key) { return promote(key, locate(key)); }
+
+    /**
+     * @brief Transparent overload of try_get, looking up a key of any type supported by Hash and KeyEqual.
+     */
+    template <class K, class = detail::enable_if_transparent<Hash, KeyEqual, K>>
+    const Value *try_get(const K &key) {
+        return promote(key, locate(key));
+    }
+
+    /**
+     * @brief Returns the value of an item, if it exists, without marking the item as the most recent one of its set.
+     *
+     * @param key The key of the item.
+     *
+     * @return A pointer to the value associated to the given key or nullptr if the key does not exist.
+     */
+    const Value *peek(const Key &key) const { return value_at(key, locate(key)); }
+
+    /**
+     * @brief Transparent overload of peek, looking up a key of any type supported by Hash and KeyEqual.
+     */
+    template <class K, class = detail::enable_if_transparent<Hash, KeyEqual, K>>
+    const Value *peek(const K &key) const {
+        return value_at(key, locate(key));
+    }
+
+    /**
+     * @brief Checks if the cache contains an item with the given key.
+     *
+     * @param key The key to check.
+     *
+     * @return true if the key exists, false otherwise.
+     */
+    bool contains(const Key &key) const { return find_slot(key, locate(key)) != slots; }
+
+    /**
+     * @brief Transparent overload of contains, looking up a key of any type supported by Hash and KeyEqual.
+     */
+    template <class K, class = detail::enable_if_transparent<Hash, KeyEqual, K>>
+    bool contains(const K &key) const {
+        return find_slot(key, locate(key)) != slots;
+    }
+
+    /**
+     * @brief Removes the item with the given key, if it exists.
+     *
+     * @param key The key of the item to remove.
+     *
+     * @return true if an item was removed, false if the key does not exist.
+     */
+    bool erase(const Key &key) { return erase_item(key, locate(key)); }
+
+    /**
+     * @brief Transparent overload of erase, looking up a key of any type supported by Hash and KeyEqual.
+     */
+    template <class K, class = detail::enable_if_transparent<Hash, KeyEqual, K>>
+    bool erase(const K &key) {
+        return erase_item(key, locate(key));
+    }
+
+   private:
+    using traits = std::allocator_traits<Allocator>;
+
+    /**
+     * @brief The number of slots of a set, one more than its ways.
+     */
+    static constexpr std::size_t slots = Ways + 1;
+
+    static constexpr std::uint8_t empty_tag = 0;
+
+    /**
+     * @brief Metadata of a set. A used slot has a tag with its high bit set and a rank, from 0 for the most recent item of
+     * the set to size - 1 for the least recent one. It is padded to a power of two size.
+     */
+    struct set_meta {
+        std::uint8_t tags[slots];
+        std::uint8_t ranks[slots];
+        std::uint8_t size;
+        std::uint8_t padding[detail::next_power_of_two(2 * slots + 1) - (2 * slots + 1)];
+    };
+
+    static_assert(sizeof(set_meta) <= 64, "The metadata of a set must fit in a cache line");
+
+    using meta_allocator = typename traits::template rebind_alloc<set_meta>;
+    using meta_traits = std::allocator_traits<meta_allocator>;
+    using item_allocator = typename traits::template rebind_alloc<item_type>;
+    using item_traits = std::allocator_traits<item_allocator>;
+
+    /**
+     * @brief The set selected by the hash of a key and the tag of the key in that set.
+     */
+    struct position {
+        std::size_t set;
+        std::uint8_t tag;
+    };
+
+    struct copy_source {
+        const item_type &operator()(item_type &item) const noexcept { return item; }
+    };
+
+    struct move_source {
+        auto operator()(item_type &item) const noexcept -> decltype(std::move_if_noexcept(item)) {
+            return std::move_if_noexcept(item);
+        }
+    };
+
+    /**
+     * @brief Returns the number of sets of a cache holding at least @p capacity items.
+     *
+     * @throws std::length_error if the capacity is zero or too large.
+     */
+    static std::size_t set_count_for(const std::size_t capacity) {
+        if (capacity == 0) {
+            detail::throw_length_error("Cache capacity must be greater than zero");
+        }
+        if (capacity > std::numeric_limits<std::size_t>::max() / 2 / slots) {
+            detail::throw_length_error("Cache capacity is too large");
+        }
+
+        return detail::next_power_of_two((capacity + Ways - 1) / Ways);
+    }
+
+    static const Value &checked_value(const Value *value) {
+        if (value == nullptr) {
+            detail::throw_out_of_range("Key not found");
+        }
+
+        return *value;
+    }
+
+    /**
+     * @brief Marks the item in @p slot as the most recent one of @p set.
+     */
+    static void touch(set_meta &set, const std::size_t slot) noexcept {
+        const auto rank = set.ranks[slot];
+        for (std::size_t other = 0; other < slots; ++other) {
+            if (set.tags[other] != empty_tag && set.ranks[other] < rank) ++set.ranks[other];
+        }
+        set.ranks[slot] = 0;
+    }
+
+    item_type *item_at(const std::size_t set, const std::size_t slot) const noexcept {
+        return items_ + set * slots + slot;
+    }
+
+    /**
+     * @brief Returns the set and the tag of a key. The set is selected by the low bits of the mixed hash and the tag is made
+     * of its 7 high bits.
+     */
+    template <class K>
+    position locate(const K &key) const {
+        const auto hash = detail::mix_hash(hash_(key));
+        return position{hash & set_mask_,
+                        static_cast<std::uint8_t>(0x80u | (hash >> (std::numeric_limits<std::size_t>::digits - 7)))};
+    }
+
+    /**
+     * @brief Finds the slot of a key in its set. Keys are only compared when their tags match.
+     *
+     * @return The slot of the item or slots if the key does not exist.
+     */
+    template <class K>
+    std::size_t find_slot(const K &key, const position where) const {
+        if (size_ == 0) return slots;
+
+        const set_meta &set = sets_[where.set];
+        for (std::size_t slot = 0; slot < slots; ++slot) {
+            if (set.tags[slot] == where.tag && equal_(item_at(where.set, slot)->first, key)) return slot;
+        }
+        return slots;
+    }
+
+    template <class K>
+    const Value *promote(const K &key, const position where) {
+        const auto slot = find_slot(key, where);
+        if (slot == slots) return nullptr;
+
+        touch(sets_[where.set], slot);
+        return &item_at(where.set, slot)->second;
+    }
+
+    template <class K>
+    const Value *value_at(const K &key, const position where) const {
+        const auto slot = find_slot(key, where);
+        return slot == slots ? nullptr : &item_at(where.set, slot)->second;
+    }
+
+    template <class K>
+    bool erase_item(const K &key, const position where) {
+        const auto slot = find_slot(key, where);
+        if (slot == slots) return false;
+
+        set_meta &set = sets_[where.set];
+        const auto rank = set.ranks[slot];
+        traits::destroy(alloc_, item_at(where.set, slot));
+        set.tags[slot] = empty_tag;
+        for (std::size_t other = 0; other < slots; ++other) {
+            if (set.tags[other] != empty_tag && set.ranks[other] > rank) --set.ranks[other];
+        }
+        --set.size;
+        --size_;
+        return true;
+    }
+
+    /**
+     * @brief Constructs an item in a free slot of its set, as the most recent one, then evicts the least recent item of the
+     * set if it holds more than Ways items. If the construction throws, the cache is left unchanged.
+     */
+    void insert_new_item(const position where, const item_type &item) {
+        if (sets_ == nullptr) allocate_sets();
+
+        set_meta &set = sets_[where.set];
+        std::size_t slot = 0;
+        while (set.tags[slot] != empty_tag) ++slot;  // a set always has a free slot between two operations
+
+        traits::construct(alloc_, item_at(where.set, slot), item);
+        for (std::size_t other = 0; other < slots; ++other) {
+            if (set.tags[other] != empty_tag) ++set.ranks[other];
+        }
+        set.tags[slot] = where.tag;
+        set.ranks[slot] = 0;
+        ++set.size;
+        ++size_;
+
+        if (set.size > Ways) evict_least_recent(where.set);
+    }
+
+    void evict_least_recent(const std::size_t set) noexcept {
+        set_meta &meta = sets_[set];
+        std::size_t slot = 0;
+        while (meta.tags[slot] == empty_tag || meta.ranks[slot] != Ways) ++slot;
+
+        traits::destroy(alloc_, item_at(set, slot));
+        meta.tags[slot] = empty_tag;
+        --meta.size;
+        --size_;
+    }
+
+    /**
+     * @brief Allocates the metadata and the items of the sets. The metadata block is allocated with one spare set, so the
+     * sets can start on a multiple of their size.
+     */
+    void allocate_sets() {
+        const std::size_t set_count = set_mask_ + 1;
+        meta_allocator meta_alloc(alloc_);
+        set_meta *const block = detail::checked_allocation(meta_traits::allocate(meta_alloc, set_count + 1));
+        auto guard = detail::make_guarded_scope(
+            [&meta_alloc, block, set_count]() { meta_traits::deallocate(meta_alloc, block, set_count + 1); });
+
+        item_allocator item_alloc(alloc_);
+        items_ = detail::checked_allocation(item_traits::allocate(item_alloc, set_count * slots));
+        guard.dismiss();
+
+        const auto misalignment = reinterpret_cast<std::uintptr_t>(block) % sizeof(set_meta);
+        const auto offset = misalignment == 0 ? 0 : sizeof(set_meta) - misalignment;
+        meta_block_ = block;
+        sets_ = reinterpret_cast<set_meta *>(reinterpret_cast<unsigned char *>(block) + offset);
+        for (std::size_t set = 0; set < set_count; ++set) ::new (static_cast<void *>(sets_ + set)) set_meta();
+    }
+
+    /**
+     * @brief Destroys the items and releases the storage of the cache.
+     */
+    void release() noexcept {
+        if (sets_ == nullptr) return;
+
+        clear();
+        const std::size_t set_count = set_mask_ + 1;
+        meta_allocator meta_alloc(alloc_);
+        meta_traits::deallocate(meta_alloc, meta_block_, set_count + 1);
+        item_allocator item_alloc(alloc_);
+        item_traits::deallocate(item_alloc, items_, set_count * slots);
+        meta_block_ = nullptr;
+        sets_ = nullptr;
+        items_ = nullptr;
+    }
+
+    /**
+     * @brief Allocates the storage of this new cache, with the sets of @p other, and constructs the items of @p other in the
+     * same slots. If constructing an item throws, the storage is released.
+     *
+     * @param other The cache to clone.
+     * @param source Returns the argument which a new item is constructed from, given the item of @p other.
+     */
+    template <class Other, class Source>
+    void clone_items(Other &other, Source source) {
+        if (other.sets_ == nullptr) return;
+
+        allocate_sets();
+        auto guard = detail::make_guarded_scope([this]() { release(); });
+        for (std::size_t set = 0; set <= set_mask_; ++set) {
+            const set_meta &other_set = other.sets_[set];
+            for (std::size_t slot = 0; slot < slots; ++slot) {
+                if (other_set.tags[slot] == empty_tag) continue;
+
+                traits::construct(alloc_, item_at(set, slot), source(*other.item_at(set, slot)));
+                sets_[set].tags[slot] = other_set.tags[slot];
+                sets_[set].ranks[slot] = other_set.ranks[slot];
+                ++sets_[set].size;
+                ++size_;
+            }
+        }
+        guard.dismiss();
+    }
+
+    void swap_storage(set_associative_cache &other) noexcept {
+        std::swap(meta_block_, other.meta_block_);
+        std::swap(sets_, other.sets_);
+        std::swap(items_, other.items_);
+        std::swap(size_, other.size_);
+    }
+
+    void swap_state(set_associative_cache &other) noexcept {
+        using std::swap;
+        swap(hash_, other.hash_);
+        swap(equal_, other.equal_);
+        swap(set_mask_, other.set_mask_);
+        swap_storage(other);
+    }
+
+    Hash hash_;
+    KeyEqual equal_;
+    Allocator alloc_;
+    std::size_t set_mask_;
+    set_meta *meta_block_{nullptr};
+    set_meta *sets_{nullptr};
+    item_type *items_{nullptr};
+    std::size_t size_{0};
+};
+
+template <class Key, class Value, std::size_t Ways, class Hash, class KeyEqual, class Allocator>
+constexpr std::size_t set_associative_cache<Key, Value, Ways, Hash, KeyEqual, Allocator>::ways;
+
+template <class Key, class Value, std::size_t Ways, class Hash, class KeyEqual, class Allocator>
+constexpr std::size_t set_associative_cache<Key, Value, Ways, Hash, KeyEqual, Allocator>::slots;
+
+template <class Key, class Value, std::size_t Ways, class Hash, class KeyEqual, class Allocator>
+constexpr std::uint8_t set_associative_cache<Key, Value, Ways, Hash, KeyEqual, Allocator>::empty_tag;
+
+}  // namespace bjg
+
+#endif
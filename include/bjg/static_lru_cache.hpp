@@ -0,0 +1,81 @@
+#ifndef BJG_STATIC_LRU_CACHE_HPP
+#define BJG_STATIC_LRU_CACHE_HPP
+
+#include <cstddef>
+#include <functional>
+#include <utility>
+
+#include "bjg/detail/flat_index.hpp"
+#include "bjg/detail/lru_cache_base.hpp"
+#include "bjg/detail/lru_slab.hpp"
+#include "bjg/detail/type_traits.hpp"
+
+namespace bjg {
+namespace detail {
+
+/**
+ * @brief Base of the lru cache holding its storage inline. The links of the slab and the slots of the index are the
+ * narrowest integers able to address its N + 1 nodes. As in lru_cache, the stored keys are not const, so they can be
+ * reassigned.
+ */
+template <class Key, class Value, std::size_t N, class Hash, class KeyEqual, bool Handles>
+using static_lru_cache_base =
+    lru_cache_base<Key, Value, Hash, KeyEqual,
+                   static_lru_slab<std::pair<Key, Value>, N + 1, index_type_for<N + 1>, Handles>,
+                   static_flat_index<index_type_for<N + 1>, N + 1>>;
+
+}  // namespace detail
+
+/**
+ * @brief Least Recently Used (LRU) cache container with a capacity fixed at compile time. After the capacity is reached,
+ * least recently used items are evicted from the cache.
+ *
+ * The items and their index are stored inline, in arrays sized from @p N, so the cache never allocates memory for itself
+ * and can live on the stack or inside other objects. The slab links and the index slots are 16 bit integers when N is
+ * lower than 65534, 32 bit integers when N is lower than 2^32 - 2. See detail::lru_cache_base for the operations.
+ *
+ * Copying or moving the cache copies or moves its items. If a copy or move assignment throws, the cache is left empty.
+ *
+ * With @p Handles, put and find return handles to the items, as with lru_cache, and each item keeps a 32 bit generation.
+ *
+ * @tparam Key The key which uniquely identifies an item from the lru cache.
+ * @tparam Value The value associated to the @p Key.
+ * @tparam N The capacity of the cache.
+ * @tparam Hash The hash function of the keys.
+ * @tparam KeyEqual The equality function of the keys.
+ * @tparam Handles Whether put and find return handles to the items.
+ */
+template <class Key, class Value, std::size_t N, class Hash = std::hash<Key>, class KeyEqual = std::equal_to<Key>,
+          bool Handles = false>
+class static_lru_cache : public detail::static_lru_cache_base<Key, Value, N, Hash, KeyEqual, Handles> {
+    using base = detail::static_lru_cache_base<Key, Value, N, Hash, KeyEqual, Handles>;
+
+    static_assert(N > 0, "Cache capacity must be greater than zero");
+
+   public:
+    /**
+     * @brief The capacity of the cache.
+     */
+    static constexpr std::size_t capacity = N;
+
+    /**
+     * @brief Creates an empty lru cache.
+     */
+    static_lru_cache() : static_lru_cache{Hash()} {}
+
+    /**
+     * @brief Creates an empty lru cache.
+     *
+     * @param hash The hash function of the keys.
+     * @param equal The equality function of the keys.
+     */
+    explicit static_lru_cache(const Hash &hash, const KeyEqual &equal = KeyEqual())
+        : base{N, hash, equal} {}
+};
+
+template <class Key, class Value, std::size_t N, class Hash, class KeyEqual, bool Handles>
+constexpr std::size_t static_lru_cache<Key, Value, N, Hash, KeyEqual, Handles>::capacity;
+
+}  // namespace bjg
+
+#endif
@@ -0,0 +1,257 @@
+#define CATCH_CONFIG_MAIN
+
+#include <catch2/catch_test_macros.hpp>
+#include <cstddef>
+#include <list>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bjg/intrusive_lru_cache.hpp"
+
+// Object owned by the tests, whose key is its name. The objects are declared before the caches linking them, so they
+// outlive their links
+struct session : bjg::lru_hook {
+    std::string name;
+    int value;
+
+    session(std::string arg_name, const int arg_value) : name{std::move(arg_name)}, value{arg_value} {}
+};
+
+struct session_name {
+    const std::string& operator()(const session& object) const noexcept { return object.name; }
+};
+
+// Object whose hash depends on its key only by its remainder, so many keys collide
+struct collider : bjg::lru_hook {
+    int key;
+
+    explicit collider(const int arg_key) : key{arg_key} {}
+};
+
+struct collider_key {
+    int operator()(const collider& object) const noexcept { return object.key; }
+};
+
+struct colliding_hash {
+    std::size_t operator()(const int key) const noexcept { return static_cast<std::size_t>(key % 4); }
+};
+
+struct transparent_string_hash {
+    using is_transparent = void;
+
+    std::size_t operator()(const char* key) const { return std::hash<std::string>{}(std::string{key}); }
+    std::size_t operator()(const std::string& key) const { return std::hash<std::string>{}(key); }
+};
+
+struct transparent_string_equal {
+    using is_transparent = void;
+
+    bool operator()(const std::string& lhs, const std::string& rhs) const { return lhs == rhs; }
+    bool operator()(const std::string& lhs, const char* rhs) const { return lhs == rhs; }
+};
+
+using session_cache = bjg::intrusive_lru_cache<session, std::string, session_name>;
+
+SCENARIO("Link objects into an intrusive lru cache and reach capacity", "[intrusive_lru_cache_put]") {
+    GIVEN("An empty intrusive lru cache of sessions with capacity = 3") {
+        session first{"first", 1}, second{"second", 2}, third{"third", 3}, fourth{"fourth", 4}, replacement{"first", 10};
+        session_cache cache{3};
+
+        CHECK(cache.empty());
+        CHECK_THROWS_AS(session_cache{0}, std::length_error);
+
+        WHEN("Three objects are linked") {
+            CHECK(cache.put(first) == nullptr);
+            CHECK(cache.put(second) == nullptr);
+            CHECK(cache.put(third) == nullptr);
+
+            THEN("They are found by their keys without being copied") {
+                CHECK(cache.size() == 3);
+                CHECK(&cache.get("first") == &first);
+                CHECK(cache.try_get("second") == &second);
+                CHECK(cache.peek("third") == &third);
+                CHECK(first.is_linked());
+                CHECK_FALSE(fourth.is_linked());
+                CHECK_THROWS_AS(cache.get("fourth"), std::out_of_range);
+            }
+        }
+
+        WHEN("A fourth object is linked after the first one is requested") {
+            cache.put(first);
+            cache.put(second);
+            cache.put(third);
+            cache.get("first");
+            session* const evicted = cache.put(fourth);
+
+            THEN("The least recent object is unlinked and returned") {
+                CHECK(evicted == &second);
+                CHECK_FALSE(second.is_linked());
+                CHECK(cache.size() == 3);
+                CHECK_FALSE(cache.contains("second"));
+                CHECK(cache.contains("first"));
+                CHECK(cache.contains("fourth"));
+            }
+        }
+
+        WHEN("An object with the key of a linked object is linked") {
+            cache.put(first);
+            cache.put(second);
+            session* const replaced = cache.put(replacement);
+
+            THEN("The linked object is replaced and returned") {
+                CHECK(replaced == &first);
+                CHECK_FALSE(first.is_linked());
+                CHECK(cache.size() == 2);
+                CHECK(cache.get("first").value == 10);
+            }
+        }
+
+        WHEN("A linked object is linked again") {
+            cache.put(first);
+            cache.put(second);
+            cache.put(third);
+            CHECK(cache.put(first) == nullptr);
+            cache.put(fourth);
+
+            THEN("It is only marked as the most recent one") {
+                CHECK(cache.size() == 3);
+                CHECK(cache.contains("first"));
+                CHECK_FALSE(cache.contains("second"));
+            }
+        }
+    }
+}
+
+SCENARIO("Unlink objects from an intrusive lru cache", "[intrusive_lru_cache_erase]") {
+    GIVEN("An intrusive lru cache of sessions holding two objects") {
+        session first{"first", 1}, second{"second", 2};
+        session_cache cache{3};
+        cache.put(first);
+        cache.put(second);
+
+        WHEN("The objects are erased by key and by reference") {
+            CHECK(cache.erase("first") == &first);
+            CHECK(cache.erase("first") == nullptr);
+            cache.erase(second);
+
+            THEN("They are unlinked") {
+                CHECK(cache.empty());
+                CHECK_FALSE(first.is_linked());
+                CHECK_FALSE(second.is_linked());
+            }
+        }
+
+        WHEN("The cache is cleared") {
+            cache.clear();
+
+            THEN("The objects are unlinked and can be linked again") {
+                CHECK(cache.empty());
+                CHECK_FALSE(first.is_linked());
+                CHECK(cache.put(first) == nullptr);
+                CHECK(cache.size() == 1);
+            }
+        }
+
+        WHEN("The cache is destroyed") {
+            { session_cache other{std::move(cache)}; }
+
+            THEN("The objects are unlinked") {
+                CHECK(cache.empty());
+                CHECK_FALSE(first.is_linked());
+                CHECK_FALSE(second.is_linked());
+            }
+        }
+
+        WHEN("A linked object is copied") {
+            const session copy{first};
+
+            THEN("The copy is not linked") { CHECK_FALSE(copy.is_linked()); }
+        }
+    }
+}
+
+SCENARIO("Move an intrusive lru cache", "[intrusive_lru_cache_move]") {
+    GIVEN("An intrusive lru cache of sessions holding two objects") {
+        session first{"first", 1}, second{"second", 2}, third{"third", 3};
+        session_cache cache{2};
+        cache.put(first);
+        cache.put(second);
+
+        WHEN("It is moved into another cache") {
+            session_cache moved{5};
+            moved.put(third);
+            moved = std::move(cache);
+
+            THEN("The other cache takes its objects and unlinks its own") {
+                CHECK(moved.size() == 2);
+                CHECK(&moved.get("first") == &first);
+                CHECK_FALSE(third.is_linked());
+                CHECK(cache.empty());
+                CHECK(moved.put(third) == &second);
+            }
+        }
+    }
+}
+
+SCENARIO("Keep the lru order of an intrusive lru cache under a random mix of operations", "[intrusive_lru_cache_random]") {
+    GIVEN("An intrusive lru cache whose keys collide, with capacity = 50") {
+        using cache_t = bjg::intrusive_lru_cache<collider, int, collider_key, colliding_hash>;
+        std::vector<collider> objects;
+        for (int key = 0; key < 120; ++key) objects.emplace_back(key);
+        cache_t cache{50, bjg::preallocate};
+        std::list<int> reference;
+        std::mt19937 generator{99};
+        std::uniform_int_distribution<int> keys{0, 119};
+
+        WHEN("Many objects are linked, requested and erased") {
+            for (int i = 0; i < 20000; ++i) {
+                const int key = keys(generator);
+                auto it = reference.begin();
+                while (it != reference.end() && *it != key) ++it;
+
+                if (i % 3 == 0) {
+                    CHECK((cache.try_get(key) != nullptr) == (it != reference.end()));
+                    if (it != reference.end()) reference.splice(reference.begin(), reference, it);
+                } else if (i % 7 == 1) {
+                    CHECK((cache.erase(key) != nullptr) == (it != reference.end()));
+                    if (it != reference.end()) reference.erase(it);
+                } else {
+                    const collider* const unlinked = cache.put(objects[static_cast<std::size_t>(key)]);
+                    if (it != reference.end()) reference.erase(it);
+                    reference.push_front(key);
+                    if (reference.size() > 50) {
+                        CHECK(unlinked == &objects[static_cast<std::size_t>(reference.back())]);
+                        reference.pop_back();
+                    } else {
+                        CHECK(unlinked == nullptr);
+                    }
+                }
+            }
+
+            THEN("The cache links exactly the most recent objects") {
+                CHECK(cache.size() == reference.size());
+                for (const int key : reference) CHECK(cache.peek(key) == &objects[static_cast<std::size_t>(key)]);
+                for (const auto& object : objects) CHECK(object.is_linked() == cache.contains(object.key));
+            }
+        }
+    }
+}
+
+SCENARIO("Look up the objects of an intrusive lru cache by C strings", "[intrusive_lru_cache_transparent_lookup]") {
+    GIVEN("An intrusive lru cache of sessions with transparent hash and equality") {
+        session first{"first", 1};
+        bjg::intrusive_lru_cache<session, std::string, session_name, transparent_string_hash, transparent_string_equal> cache{
+            4};
+        cache.put(first);
+
+        THEN("The objects are found and erased by C strings") {
+            CHECK(cache.get("first").value == 1);
+            CHECK(cache.contains("first"));
+            CHECK(cache.erase("first") == &first);
+            CHECK(cache.try_get("first") == nullptr);
+        }
+    }
+}
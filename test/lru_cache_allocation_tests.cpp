@@ -0,0 +1,209 @@
+#define CATCH_CONFIG_MAIN
+
+#include <catch2/catch_test_macros.hpp>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bjg/intrusive_lru_cache.hpp"
+#include "bjg/lru_cache.hpp"
+#include "bjg/static_lru_cache.hpp"
+
+namespace {
+std::size_t allocations = 0;
+}  // namespace
+
+void* operator new(std::size_t size) {
+    ++allocations;
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) return memory;
+    throw std::bad_alloc{};
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    ++allocations;
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+
+struct transparent_string_hash {
+    using is_transparent = void;
+
+    std::size_t operator()(const char* key) const noexcept {
+        std::size_t hash = 14695981039346656037ULL;
+        for (; *key != '\0'; ++key) hash = (hash ^ static_cast<unsigned char>(*key)) * 1099511628211ULL;
+        return hash;
+    }
+    std::size_t operator()(const std::string& key) const noexcept { return (*this)(key.c_str()); }
+};
+
+struct transparent_string_equal {
+    using is_transparent = void;
+
+    bool operator()(const std::string& lhs, const std::string& rhs) const noexcept { return lhs == rhs; }
+    bool operator()(const std::string& lhs, const char* rhs) const noexcept { return lhs == rhs; }
+};
+
+SCENARIO("Operate on a preallocated lru cache without allocating", "[lru_cache_preallocate]") {
+    GIVEN("A preallocated lru cache with key:int, value:int, capacity = 1000") {
+        using lru_cache_t = bjg::lru_cache<int, int>;
+        const auto before_construction = allocations;
+        lru_cache_t cache{1000, bjg::preallocate};
+        const auto construction_allocations = allocations - before_construction;
+
+        REQUIRE(construction_allocations > 0);
+
+        WHEN("The lru cache is filled, then items are requested, updated and evicted many times") {
+            const auto before_operations = allocations;
+            for (int i = 0; i < 100000; ++i) {
+                cache.put(std::make_pair(i % 3000, i));
+                cache.put(std::make_pair((i * 7) % 3000, i));
+                cache.try_get((i * 13) % 3000);
+                if (cache.contains((i * 17) % 3000)) cache.get((i * 17) % 3000);
+            }
+            const auto operations_allocations = allocations - before_operations;
+
+            THEN("No memory was allocated after the construction") {
+                CHECK(operations_allocations == 0);
+                CHECK(cache.size() == 1000);
+            }
+        }
+    }
+}
+
+SCENARIO("Put new items into a full lru cache without allocating nodes", "[lru_cache_recycle]") {
+    GIVEN("A full preallocated lru cache with key:std::string, value:std::string, capacity = 100") {
+        using lru_cache_t = bjg::lru_cache<std::string, std::string>;
+        std::vector<lru_cache_t::item_type> items;
+        for (int i = 0; i < 1000; ++i) {
+            const auto key = std::to_string(10000 + i);
+            items.emplace_back("a key which does not fit the small string buffer " + key,
+                               "a value which does not fit the small string buffer " + key);
+        }
+        lru_cache_t cache{100, bjg::preallocate};
+        for (int i = 0; i < 100; ++i) cache.put(items[static_cast<std::size_t>(i)]);
+
+        WHEN("New items are moved in, each evicting the least recent item") {
+            const auto last_item = items.back();
+            const auto before_puts = allocations;
+            for (std::size_t i = 100; i < items.size(); ++i) cache.put(std::move(items[i]));
+            const auto puts_allocations = allocations - before_puts;
+
+            THEN("Only the const keys of the new items are copied, then moved into the nodes of the evicted ones") {
+                CHECK(puts_allocations == items.size() - 100);
+                CHECK(cache.size() == 100);
+                CHECK(cache.get(last_item.first) == last_item.second);
+            }
+        }
+    }
+}
+
+SCENARIO("Clear and refill a lru cache without allocating", "[lru_cache_clear]") {
+    GIVEN("A full preallocated lru cache with key:int, value:std::string, capacity = 1000") {
+        using lru_cache_t = bjg::lru_cache<int, std::string>;
+        lru_cache_t cache{1000, bjg::preallocate};
+        for (int i = 0; i < 1000; ++i) cache.put(std::make_pair(i, std::string{}));
+
+        WHEN("It is cleared and refilled many times") {
+            const auto before_operations = allocations;
+            for (int round = 0; round < 100; ++round) {
+                cache.clear();
+                for (int i = 0; i < 1000; ++i) cache.put(std::make_pair(round * 1000 + i, std::string{}));
+            }
+            const auto operations_allocations = allocations - before_operations;
+
+            THEN("No memory was allocated") {
+                CHECK(operations_allocations == 0);
+                CHECK(cache.size() == 1000);
+                CHECK(cache.contains(99999));
+                CHECK_FALSE(cache.contains(98999));
+            }
+        }
+    }
+}
+
+SCENARIO("Look up string keys by C strings without allocating", "[lru_cache_transparent_lookup]") {
+    GIVEN("A lru cache with key:std::string, value:int, transparent hash and equality and capacity = 10") {
+        using lru_cache_t = bjg::lru_cache<std::string, int, transparent_string_hash, transparent_string_equal>;
+        lru_cache_t cache{10};
+        const char* const key = "a key which does not fit the small string buffer";
+        cache.put(std::make_pair(std::string{key}, 1));
+
+        WHEN("The item is looked up and erased by a C string") {
+            const auto before_lookups = allocations;
+            const auto value = cache.get(key);
+            const auto found = cache.contains(key) && cache.try_get(key) != nullptr && cache.peek(key) != nullptr;
+            const auto erased = cache.erase(key);
+            const auto lookups_allocations = allocations - before_lookups;
+
+            THEN("No temporary key was allocated") {
+                CHECK(value == 1);
+                CHECK(found);
+                CHECK(erased);
+                CHECK(lookups_allocations == 0);
+            }
+        }
+    }
+}
+
+SCENARIO("Operate on a static lru cache without allocating", "[static_lru_cache_no_allocation]") {
+    GIVEN("A static lru cache type with key:int, value:int, capacity = 1000") {
+        using lru_cache_t = bjg::static_lru_cache<int, int, 1000>;
+
+        WHEN("A lru cache is created, filled, used and copied") {
+            const auto before_construction = allocations;
+            lru_cache_t cache;
+            for (int i = 0; i < 100000; ++i) {
+                cache.put(std::make_pair(i % 3000, i));
+                cache.try_get((i * 13) % 3000);
+                if (i % 7 == 0) cache.erase((i * 17) % 3000);
+            }
+            const auto copy = cache;
+            const auto total_allocations = allocations - before_construction;
+
+            THEN("No memory was allocated") {
+                CHECK(total_allocations == 0);
+                CHECK(copy.size() == cache.size());
+            }
+        }
+    }
+}
+
+struct hooked_int : bjg::lru_hook {
+    int key;
+
+    explicit hooked_int(const int arg_key) : key{arg_key} {}
+};
+
+struct hooked_int_key {
+    int operator()(const hooked_int& object) const noexcept { return object.key; }
+};
+
+SCENARIO("Link objects into a preallocated intrusive lru cache without allocating", "[intrusive_lru_cache_preallocate]") {
+    GIVEN("A preallocated intrusive lru cache with key:int, capacity = 1000, and 3000 objects") {
+        std::vector<hooked_int> objects;
+        for (int key = 0; key < 3000; ++key) objects.emplace_back(key);
+        bjg::intrusive_lru_cache<hooked_int, int, hooked_int_key> cache{1000, bjg::preallocate};
+
+        WHEN("The objects are linked, requested and unlinked many times") {
+            const auto before_operations = allocations;
+            for (int i = 0; i < 100000; ++i) {
+                cache.put(objects[static_cast<std::size_t>(i % 3000)]);
+                cache.try_get((i * 13) % 3000);
+                if (i % 7 == 0) cache.erase((i * 17) % 3000);
+            }
+            const auto operations_allocations = allocations - before_operations;
+
+            THEN("No memory was allocated after the construction") {
+                CHECK(operations_allocations == 0);
+                CHECK(cache.size() <= 1000);
+            }
+        }
+    }
+}
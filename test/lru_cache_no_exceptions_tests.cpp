@@ -0,0 +1,64 @@
+// Built with exceptions disabled, which Catch2 does not support, so the checks are plain asserts on the exit status
+
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <utility>
+
+#include "bjg/intrusive_lru_cache.hpp"
+#include "bjg/lru_cache.hpp"
+#include "bjg/set_associative_cache.hpp"
+#include "bjg/static_lru_cache.hpp"
+
+#if !defined(BJG_LRU_CACHE_NO_EXCEPTIONS)
+#error "The lru cache must detect that exceptions are disabled"
+#endif
+
+namespace {
+int failures = 0;
+
+void check(const bool condition, const char *what) {
+    if (condition) return;
+
+    std::fprintf(stderr, "Check failed: %s\n", what);
+    ++failures;
+}
+}  // namespace
+
+int main() {
+    using lru_cache_t =
+        bjg::lru_cache<int, int, std::hash<int>, std::equal_to<int>, bjg::nothrow_allocator<std::pair<const int, int>>>;
+
+    auto created = lru_cache_t::create(100);
+    check(static_cast<bool>(created), "a lru cache with a valid capacity is created");
+    if (created) {
+        for (int i = 0; i < 1000; ++i) created->put(std::make_pair(i, i * 2));
+        check(created->size() == 100, "a full lru cache keeps its capacity");
+        check(created->try_get(999) != nullptr && *created->try_get(999) == 1998, "try_get finds the most recent item");
+        check(created->try_get(899) == nullptr, "try_get reports the evicted items");
+        check(created->peek(900) != nullptr, "peek finds the least recent item");
+        check(created->update(950, [](int &value) { value = -1; }) && *created->peek(950) == -1, "update finds an item");
+    }
+
+    check(lru_cache_t::create(0).error() == bjg::cache_errc::invalid_capacity, "a zero capacity is reported");
+    check(bjg::compact_lru_cache<int, int, 10>::create(11).error() == bjg::cache_errc::invalid_capacity,
+          "a capacity above the maximum capacity is reported");
+    check(lru_cache_t::create(static_cast<std::size_t>(-1)).error() == bjg::cache_errc::invalid_capacity,
+          "a capacity whose storage cannot be addressed is reported");
+
+    auto strings = bjg::split_lru_cache<std::string, std::string>::create(2);
+    check(static_cast<bool>(strings), "a split lru cache is created");
+    if (strings) {
+        strings->put(std::make_pair(std::string{"one"}, std::string{"1"}));
+        strings->put(std::make_pair(std::string{"two"}, std::string{"2"}));
+        strings->put(std::make_pair(std::string{"three"}, std::string{"3"}));
+        check(!strings->contains("one") && *strings->peek("three") == "3", "a split lru cache evicts its items");
+    }
+
+    bjg::static_lru_cache<int, int, 4> static_cache;
+    for (int i = 0; i < 10; ++i) static_cache.put(std::make_pair(i, i));
+    check(static_cache.size() == 4 && static_cache.try_get(9) != nullptr, "a static lru cache evicts its items");
+
+    return failures == 0 ? 0 : 1;
+}
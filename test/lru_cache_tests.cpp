@@ -2,11 +2,19 @@
 
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers.hpp>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <new>
+#include <random>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "bjg/lru_cache.hpp"
+#include "bjg/static_lru_cache.hpp"
 
 constexpr int kInvalidArgValue = 1024;
 
@@ -19,17 +27,181 @@ struct int_wrapper {
 
 struct invalid_hashing_argument : public std::exception {};
 
+int counted_int_hashes = 0;
+int counted_int_comparisons = 0;
+
+struct counted_int {
+    int value{0};
+
+    explicit counted_int(const int arg_value) : value{arg_value} {}
+    bool operator==(const counted_int& other) const {
+        ++counted_int_comparisons;
+        return value == other.value;
+    }
+};
+
+struct copy_counted_key {
+    static int copies;
+    int value{0};
+
+    explicit copy_counted_key(const int arg_value) : value{arg_value} {}
+    copy_counted_key(const copy_counted_key& other) : value{other.value} { ++copies; }
+    copy_counted_key& operator=(const copy_counted_key& other) = default;
+    bool operator==(const copy_counted_key& other) const { return value == other.value; }
+};
+
+int copy_counted_key::copies = 0;
+
+// Value whose copies and copy assignments throw while armed
+struct throwing_value {
+    static bool armed;
+    std::string text;
+
+    explicit throwing_value(std::string arg_text) : text{std::move(arg_text)} {}
+    throwing_value(const throwing_value& other) : text{other.text} {
+        if (armed) throw std::runtime_error{"copy failed"};
+    }
+    throwing_value& operator=(const throwing_value& other) {
+        if (armed) throw std::runtime_error{"copy failed"};
+        text = other.text;
+        return *this;
+    }
+};
+
+bool throwing_value::armed = false;
+
+// Value whose copies throw when throwing_value is armed, but whose moves cannot throw
+struct movable_throwing_value {
+    std::string text;
+
+    explicit movable_throwing_value(std::string arg_text) : text{std::move(arg_text)} {}
+    movable_throwing_value(const movable_throwing_value& other) : text{other.text} {
+        if (throwing_value::armed) throw std::runtime_error{"copy failed"};
+    }
+    movable_throwing_value(movable_throwing_value&&) noexcept = default;
+    movable_throwing_value& operator=(const movable_throwing_value& other) {
+        if (throwing_value::armed) throw std::runtime_error{"copy failed"};
+        text = other.text;
+        return *this;
+    }
+    movable_throwing_value& operator=(movable_throwing_value&&) noexcept = default;
+};
+
+// Value counting its constructions, copies and moves
+struct counted_value {
+    static int constructions;
+    static int copies;
+    static int moves;
+    int first;
+    int second;
+
+    counted_value(const int arg_first, const int arg_second) : first{arg_first}, second{arg_second} { ++constructions; }
+    counted_value(const counted_value& other) : first{other.first}, second{other.second} { ++copies; }
+    counted_value(counted_value&& other) noexcept : first{other.first}, second{other.second} { ++moves; }
+    counted_value& operator=(const counted_value& other) = default;
+    counted_value& operator=(counted_value&& other) noexcept = default;
+
+    static void reset() { constructions = copies = moves = 0; }
+};
+
+int counted_value::constructions = 0;
+int counted_value::copies = 0;
+int counted_value::moves = 0;
+
+// Value which counts its living instances, to check when the items are destroyed
+struct live_value {
+    static int count;
+    int value;
+
+    explicit live_value(const int arg_value) : value{arg_value} { ++count; }
+    live_value(const live_value& other) : value{other.value} { ++count; }
+    live_value& operator=(const live_value& other) = default;
+    ~live_value() { --count; }
+};
+
+int live_value::count = 0;
+
+struct allocation_counters {
+    int allocations{0};
+    int live_blocks{0};
+    // Once this many blocks are allocated, the allocator returns nullptr, as a nothrow allocator does; -1 for no limit
+    int allocation_limit{-1};
+};
+
+// Stateful allocator which does not propagate and counts the blocks allocated through it
+template <class T>
+struct counting_allocator {
+    using value_type = T;
+
+    allocation_counters* counters;
+
+    explicit counting_allocator(allocation_counters* arg_counters) : counters{arg_counters} {}
+    template <class U>
+    counting_allocator(const counting_allocator<U>& other) : counters{other.counters} {}
+
+    T* allocate(const std::size_t count) {
+        if (counters->allocations == counters->allocation_limit) return nullptr;
+        ++counters->allocations;
+        ++counters->live_blocks;
+        return std::allocator<T>().allocate(count);
+    }
+
+    void deallocate(T* pointer, const std::size_t count) {
+        --counters->live_blocks;
+        std::allocator<T>().deallocate(pointer, count);
+    }
+
+    template <class U>
+    bool operator==(const counting_allocator<U>& other) const {
+        return counters == other.counters;
+    }
+    template <class U>
+    bool operator!=(const counting_allocator<U>& other) const {
+        return counters != other.counters;
+    }
+};
+
+// Transparent hash and equality of string keys, which also accept C strings
+struct transparent_string_hash {
+    using is_transparent = void;
+
+    std::size_t operator()(const char* key) const noexcept {
+        std::size_t hash = 14695981039346656037ULL;
+        for (; *key != '\0'; ++key) hash = (hash ^ static_cast<unsigned char>(*key)) * 1099511628211ULL;
+        return hash;
+    }
+    std::size_t operator()(const std::string& key) const noexcept { return (*this)(key.c_str()); }
+};
+
+struct transparent_string_equal {
+    using is_transparent = void;
+
+    bool operator()(const std::string& lhs, const std::string& rhs) const noexcept { return lhs == rhs; }
+    bool operator()(const std::string& lhs, const char* rhs) const noexcept { return lhs == rhs; }
+};
+
+// Dummy fault injection: while armed, hashing kInvalidArgValue throws
+bool invalid_hashing_armed = false;
+
 namespace std {
 template <>
 struct hash<int_wrapper> {
     size_t operator()(const int_wrapper& x) const {
-        // Dummy fault injection
-        if (x.value == kInvalidArgValue) {
-            static int invalid_times = 0;
-            invalid_times++;
-            if (invalid_times == 2 || invalid_times == 5) throw invalid_hashing_argument{};
-        }
+        if (x.value == kInvalidArgValue && invalid_hashing_armed) throw invalid_hashing_argument{};
+
+        return hash<int>()(x.value);
+    }
+};
+
+template <>
+struct hash<copy_counted_key> {
+    size_t operator()(const copy_counted_key& x) const { return hash<int>()(x.value); }
+};
 
+template <>
+struct hash<counted_int> {
+    size_t operator()(const counted_int& x) const {
+        ++counted_int_hashes;
         return hash<int>()(x.value);
     }
 };
@@ -51,6 +223,29 @@ SCENARIO("Create a lru cache with different sizes", "[lru_cache_constructor]") {
             }
         }
     }
+
+    GIVEN("Lru caches with key:int or key:std::string, created with capacity SIZE_MAX or SIZE_MAX - 1 to be unbounded") {
+        bjg::lru_cache<int, int> int_cache{static_cast<std::size_t>(-1)};
+        bjg::lru_cache<std::string, int> string_cache{static_cast<std::size_t>(-1)};
+        bjg::lru_cache<int, int> almost_unbounded_cache{static_cast<std::size_t>(-1) - 1};
+
+        WHEN("Items are put") {
+            for (int i = 0; i < 1000; ++i) {
+                int_cache.put(std::make_pair(i, i));
+                string_cache.put(std::make_pair(std::to_string(i), i));
+                almost_unbounded_cache.put(std::make_pair(i, i));
+            }
+
+            THEN("No item is evicted") {
+                CHECK(int_cache.size() == 1000);
+                CHECK(string_cache.size() == 1000);
+                CHECK(almost_unbounded_cache.size() == 1000);
+                CHECK(int_cache.get(0) == 0);
+                CHECK(string_cache.get("0") == 0);
+                CHECK(almost_unbounded_cache.get(0) == 0);
+            }
+        }
+    }
 }
 
 SCENARIO("Insert items into lru cache without exceeding capacity", "[lru_cache_insert_items]") {
@@ -214,33 +409,45 @@ SCENARIO("Throw exceptions when adding items and check exception safety", "[lru_
     GIVEN("An empty lru cache with key:int_wrapper, value:std::string, capacity = 3") {
         using lru_cache_t = bjg::lru_cache<int_wrapper, std::string>;
         lru_cache_t cache{3};
+        invalid_hashing_armed = false;
 
         WHEN("An exception is thrown during insertion, the lru_cache is still empty") {
+            invalid_hashing_armed = true;
             CHECK_THROWS_AS([&cache]() { cache.put(std::make_pair(int_wrapper{kInvalidArgValue}, "invalid")); }(),
                             invalid_hashing_argument);
+            invalid_hashing_armed = false;
             CHECK(cache.size() == 0);
             CHECK(cache.empty());
         }
 
-        WHEN("An exception is triggered by eviction during insertion, the cache does not change") {
-            cache.put(std::make_pair(int_wrapper{kInvalidArgValue}, "invalid"));  // hashing won't fail this time
+        WHEN("Hashing fails during insertion in a full cache, the cache does not change") {
+            cache.put(std::make_pair(int_wrapper{1}, "one"));
             cache.put(std::make_pair(int_wrapper{2}, "two"));
             cache.put(std::make_pair(int_wrapper{3}, "three"));
 
-            // At this point, the cache reached its capacity and a newly inserted item will trigger the error injected eviction
-            CHECK_THROWS_AS([&cache]() { cache.put(std::make_pair(int_wrapper{4}, "four")); }(), invalid_hashing_argument);
+            invalid_hashing_armed = true;
+            CHECK_THROWS_AS([&cache]() { cache.put(std::make_pair(int_wrapper{kInvalidArgValue}, "invalid")); }(),
+                            invalid_hashing_argument);
+            invalid_hashing_armed = false;
 
             // As insertion triggered exception, the cache must be unchanged
             CHECK(cache.size() == 3);
-            CHECK(cache.contains(int_wrapper{kInvalidArgValue}));
-            CHECK(cache.get(int_wrapper{kInvalidArgValue}) == "invalid");
-            CHECK(cache.contains(int_wrapper{2}));
+            CHECK_FALSE(cache.contains(int_wrapper{kInvalidArgValue}));
+            CHECK(cache.get(int_wrapper{1}) == "one");
             CHECK(cache.get(int_wrapper{2}) == "two");
-            CHECK(cache.contains(int_wrapper{3}));
             CHECK(cache.get(int_wrapper{3}) == "three");
+        }
+
+        WHEN("The least recent key can no longer be hashed when it is evicted") {
+            cache.put(std::make_pair(int_wrapper{kInvalidArgValue}, "invalid"));  // hashing won't fail this time
+            cache.put(std::make_pair(int_wrapper{2}, "two"));
+            cache.put(std::make_pair(int_wrapper{3}, "three"));
+
+            // The stored hash is used to evict the "invalid" item, so its key is not hashed again
+            invalid_hashing_armed = true;
+            CHECK_NOTHROW(cache.put(std::make_pair(int_wrapper{4}, "four")));
+            invalid_hashing_armed = false;
 
-            // Now eviction should not trigger any error, the "invalid" item is the oldest and it will be evicted
-            cache.put(std::make_pair(int_wrapper{4}, "four"));
             CHECK(cache.size() == 3);
             CHECK_FALSE(cache.contains(int_wrapper{kInvalidArgValue}));
             CHECK(cache.contains(int_wrapper{2}));
@@ -252,3 +459,1436 @@ SCENARIO("Throw exceptions when adding items and check exception safety", "[lru_
         }
     }
 }
+
+SCENARIO("Grow the lru cache storage while inserting items", "[lru_cache_storage_growth]") {
+    GIVEN("An empty lru cache with key:int, value:std::string, capacity = 100") {
+        using lru_cache_t = bjg::lru_cache<int, std::string>;
+        lru_cache_t cache{100};
+
+        WHEN("More items are inserted than the initial storage can hold") {
+            for (int i = 0; i < 150; ++i) {
+                cache.put(std::make_pair(i, std::to_string(i)));
+            }
+
+            THEN("The items survive the storage growth and the least recent ones are evicted") {
+                CHECK(cache.size() == 100);
+                CHECK_FALSE(cache.contains(49));
+                for (int i = 50; i < 150; ++i) {
+                    CHECK(cache.get(i) == std::to_string(i));
+                }
+            }
+        }
+
+        WHEN("The lru cache is copied") {
+            for (int i = 0; i < 40; ++i) {
+                cache.put(std::make_pair(i, std::to_string(i)));
+            }
+            lru_cache_t copy{cache};
+            copy.put(std::make_pair(0, "zero"));
+            copy.put(std::make_pair(100, "hundred"));
+
+            THEN("The copy keeps the items and the recency order, independently of the original") {
+                CHECK(copy.size() == 41);
+                CHECK(copy.get(0) == "zero");
+                CHECK(copy.get(39) == "39");
+                CHECK(cache.size() == 40);
+                CHECK(cache.get(0) == "0");
+                CHECK_FALSE(cache.contains(100));
+            }
+        }
+    }
+}
+
+// Runs a random mix of put/get/contains on the cache and on a reference list of the most recent items, checking that they
+// agree, then checks that the cache holds exactly the items of the reference list
+template <class LruCache>
+void check_random_operations(LruCache& cache, const std::size_t capacity, const int operations) {
+    std::list<std::pair<std::string, int>> reference;
+    std::mt19937 generator{42};
+    std::uniform_int_distribution<int> keys{0, 999};
+
+    for (int i = 0; i < operations; ++i) {
+        const auto key = std::to_string(keys(generator));
+        auto it = reference.begin();
+        while (it != reference.end() && it->first != key) ++it;
+
+        if (i % 3 == 0) {
+            CHECK(cache.contains(key) == (it != reference.end()));
+            if (it != reference.end()) {
+                CHECK(cache.get(key) == it->second);
+                reference.splice(reference.begin(), reference, it);
+            }
+        } else if (i % 5 == 1) {
+            CHECK(cache.erase(key) == (it != reference.end()));
+            if (it != reference.end()) reference.erase(it);
+        } else {
+            cache.put(std::make_pair(key, i));
+            if (it != reference.end()) reference.erase(it);
+            reference.emplace_front(key, i);
+            if (reference.size() > capacity) reference.pop_back();
+        }
+    }
+
+    CHECK(cache.size() == reference.size());
+    for (const auto& item : reference) {
+        CHECK(cache.peek(item.first) != nullptr);
+    }
+}
+
+SCENARIO("Keep the lru order under a random mix of operations", "[lru_cache_random_operations]") {
+    GIVEN("A lru cache with key:std::string, value:int, capacity = 200") {
+        bjg::lru_cache<std::string, int> cache{200};
+
+        WHEN("Many items are put and requested") {
+            THEN("The lru cache holds exactly the most recent items") { check_random_operations(cache, 200, 20000); }
+        }
+    }
+
+    GIVEN("A preallocated lru cache with key:std::string, value:int, capacity = 24, whose index is mostly full") {
+        bjg::lru_cache<std::string, int> cache{24, bjg::preallocate};
+
+        WHEN("Many items are put and requested, so the deleted index buckets are dropped in place") {
+            THEN("The lru cache holds exactly the most recent items") { check_random_operations(cache, 24, 20000); }
+        }
+    }
+
+    GIVEN("A compact lru cache with key:std::string, value:int, capacity = 200 and 16 bit links") {
+        bjg::compact_lru_cache<std::string, int, 1000> cache{200};
+
+        WHEN("Many items are put and requested") {
+            THEN("The lru cache holds exactly the most recent items") { check_random_operations(cache, 200, 20000); }
+        }
+    }
+
+    GIVEN("A split lru cache with key:std::string, value:int, capacity = 200") {
+        bjg::split_lru_cache<std::string, int> cache{200};
+
+        WHEN("Many items are put and requested") {
+            THEN("The lru cache holds exactly the most recent items") { check_random_operations(cache, 200, 20000); }
+        }
+    }
+}
+
+SCENARIO("Bound the capacity of a compact lru cache", "[lru_cache_compact]") {
+    GIVEN("Compact lru cache types with different maximum capacities") {
+        using small_cache_t = bjg::compact_lru_cache<int, int, 1000>;
+        using medium_cache_t = bjg::compact_lru_cache<int, int, 100000>;
+
+        THEN("Their links are as narrow as their maximum capacity allows") {
+            CHECK(sizeof(small_cache_t::items_list_index) == 2);
+            CHECK(sizeof(medium_cache_t::items_list_index) == 4);
+            CHECK(sizeof(bjg::lru_cache<int, int>::items_list_index) == sizeof(std::size_t));
+            CHECK(sizeof(small_cache_t::items_list::hash_type) == 4);
+        }
+
+        WHEN("A cache is created with its maximum capacity and filled past it") {
+            small_cache_t cache{1000, bjg::preallocate};
+            for (int i = 0; i < 1500; ++i) cache.put(std::make_pair(i, i));
+
+            THEN("The least recent items are evicted") {
+                CHECK(cache.size() == 1000);
+                CHECK_FALSE(cache.contains(499));
+                CHECK(cache.get(500) == 500);
+                CHECK(cache.get(1499) == 1499);
+            }
+        }
+
+        WHEN("A cache is created with a capacity greater than its maximum capacity") {
+            THEN("A length_error exception is thrown") { CHECK_THROWS_AS(small_cache_t{1001}, std::length_error); }
+        }
+    }
+}
+
+// Runs a random mix of put/get/erase on a cache with integer keys and on a reference list of the most recent items, then
+// checks that the cache holds exactly the items of the reference list
+template <class LruCache, class Key>
+void check_random_integer_operations(LruCache& cache, const std::size_t capacity, const Key stride, const Key offset) {
+    std::list<std::pair<Key, int>> reference;
+    std::mt19937 generator{1234};
+    std::uniform_int_distribution<int> keys{0, 300};
+
+    for (int i = 0; i < 20000; ++i) {
+        const auto key = static_cast<Key>(static_cast<Key>(keys(generator)) * stride + offset);
+        auto it = reference.begin();
+        while (it != reference.end() && it->first != key) ++it;
+
+        if (i % 3 == 0) {
+            const int* value = cache.try_get(key);
+            CHECK((value != nullptr) == (it != reference.end()));
+            if (it != reference.end()) {
+                CHECK(*value == it->second);
+                reference.splice(reference.begin(), reference, it);
+            }
+        } else if (i % 3 == 1) {
+            CHECK(cache.erase(key) == (it != reference.end()));
+            if (it != reference.end()) reference.erase(it);
+        } else {
+            cache.put(std::make_pair(key, i));
+            if (it != reference.end()) reference.erase(it);
+            reference.emplace_front(key, i);
+            if (reference.size() > capacity) reference.pop_back();
+        }
+    }
+
+    CHECK(cache.size() == reference.size());
+    for (const auto& item : reference) CHECK(*cache.peek(item.first) == item.second);
+}
+
+SCENARIO("Store integer keys inline in the keys index", "[lru_cache_integer_keys]") {
+    GIVEN("Lru cache types with integer and non integer keys") {
+        THEN("Only the integer keys with the standard hash and equality use the integer index") {
+            using integer_keys_t = bjg::lru_cache<std::uint64_t, int>::keys_type;
+            using compact_integer_keys_t = bjg::compact_lru_cache<int, int, 1000>::keys_type;
+            using custom_hash_keys_t = bjg::lru_cache<int, int, transparent_string_hash>::keys_type;
+            CHECK(std::is_same<integer_keys_t, bjg::detail::integer_index<std::uint64_t, std::size_t>>::value);
+            CHECK(std::is_same<compact_integer_keys_t, bjg::detail::integer_index<int, std::uint16_t>>::value);
+            CHECK_FALSE(std::is_same<custom_hash_keys_t, bjg::detail::integer_index<int, std::size_t>>::value);
+            CHECK_FALSE(std::is_same<bjg::lru_cache<std::string, int>::keys_type,
+                                     bjg::detail::integer_index<std::string, std::size_t>>::value);
+        }
+
+        THEN("Only the items of the other keys keep their hashes") {
+            CHECK_FALSE(bjg::lru_cache<std::uint64_t, int>::items_list::has_hashes);
+            CHECK_FALSE(bjg::split_lru_cache<int, std::string>::items_list::has_hashes);
+            CHECK(bjg::lru_cache<int, int, transparent_string_hash>::items_list::has_hashes);
+            CHECK(bjg::lru_cache<std::string, int>::items_list::has_hashes);
+        }
+    }
+
+    GIVEN("A lru cache with key:int, value:int, capacity = 10, holding one item put with a hash") {
+        bjg::lru_cache<int, int> cache{10};
+        cache.put(std::make_pair(8, 80), cache.hash_function()(8));
+
+        THEN("The overloads taking a hash ignore it, as integer keys are never hashed") {
+            CHECK(*cache.try_get(8, 0) == 80);
+            CHECK(*cache.peek(8, 12345) == 80);
+            CHECK(cache.contains(8, cache.hash_function()(9)));
+            CHECK(cache.erase(8, 1));
+            CHECK(cache.empty());
+        }
+    }
+
+    GIVEN("A lru cache with key:std::uint64_t, value:int, capacity = 100") {
+        bjg::lru_cache<std::uint64_t, int> cache{100};
+
+        WHEN("Many keys differing only in their high bits are put, erased and requested") {
+            THEN("The lru cache holds exactly the most recent items") {
+                check_random_integer_operations(cache, 100, std::uint64_t{1} << 40, std::uint64_t{7});
+            }
+        }
+    }
+
+    GIVEN("A compact lru cache with key:int, value:int, capacity = 50") {
+        bjg::compact_lru_cache<int, int, 50> cache{50};
+
+        WHEN("Many negative keys are put, erased and requested") {
+            THEN("The lru cache holds exactly the most recent items") { check_random_integer_operations(cache, 50, -3, -1); }
+        }
+    }
+
+    GIVEN("A lru cache with key:int, value:int, capacity = 100 and a copy of it") {
+        bjg::lru_cache<int, int> cache{100};
+        for (int i = 0; i < 150; ++i) cache.put(std::make_pair(i, i));
+        auto copy = cache;
+
+        WHEN("The original is cleared") {
+            cache.clear();
+
+            THEN("The copy keeps its own index") {
+                CHECK(cache.empty());
+                CHECK_FALSE(cache.contains(100));
+                CHECK(copy.size() == 100);
+                for (int i = 50; i < 150; ++i) CHECK(copy.get(i) == i);
+            }
+        }
+    }
+}
+
+SCENARIO("Store the values of a split lru cache apart from the keys", "[lru_cache_split_layout]") {
+    GIVEN("An empty split lru cache with key:int, value:std::string, capacity = 100 and a counting allocator") {
+        using allocator_t = counting_allocator<std::pair<const int, std::string>>;
+        using lru_cache_t = bjg::split_lru_cache<int, std::string, std::hash<int>, std::equal_to<int>, allocator_t>;
+        allocation_counters counters;
+        lru_cache_t cache{100, allocator_t{&counters}};
+
+        WHEN("More items are inserted than the initial storage can hold") {
+            for (int i = 0; i < 150; ++i) cache.put(std::make_pair(i, std::to_string(i)));
+
+            THEN("The keys and the values survive the storage growth and the least recent ones are evicted") {
+                CHECK(cache.size() == 100);
+                CHECK_FALSE(cache.contains(49));
+                for (int i = 50; i < 150; ++i) CHECK(cache.get(i) == std::to_string(i));
+            }
+        }
+
+        WHEN("The lru cache is copied and moved to another allocator") {
+            for (int i = 0; i < 40; ++i) cache.put(std::make_pair(i, std::to_string(i)));
+            allocation_counters other_counters;
+            lru_cache_t copy{1, allocator_t{&other_counters}};
+            copy = cache;
+            copy.put(std::make_pair(0, "zero"));
+            lru_cache_t moved{1, allocator_t{&other_counters}};
+            moved = std::move(cache);
+
+            THEN("The items are cloned into the storage of the other allocator, nodes and values apart") {
+                CHECK(copy.size() == 40);
+                CHECK(copy.get(0) == "zero");
+                CHECK(copy.get(39) == "39");
+                CHECK(moved.size() == 40);
+                CHECK(moved.get(0) == "0");
+                // Each cache holds its nodes, its values and the buckets of its integer keys index
+                CHECK(other_counters.live_blocks == 6);
+            }
+        }
+
+        WHEN("All the storage is released") {
+            for (int i = 0; i < 150; ++i) cache.put(std::make_pair(i, std::to_string(i)));
+            cache = lru_cache_t{1, allocator_t{&counters}};
+
+            THEN("The nodes and the values blocks are all deallocated") { CHECK(counters.live_blocks == 0); }
+        }
+    }
+
+    GIVEN("A split lru cache with key:int, value:throwing_value, size = 2 and capacity = 3") {
+        bjg::split_lru_cache<int, throwing_value> cache{3};
+        throwing_value::armed = false;
+        cache.put(std::make_pair(1, throwing_value{"one"}));
+        cache.put(std::make_pair(2, throwing_value{"two"}));
+
+        WHEN("Copying a new value throws") {
+            const std::pair<const int, throwing_value> item{3, throwing_value{"three"}};
+            throwing_value::armed = true;
+            CHECK_THROWS_AS(cache.put(item), std::runtime_error);
+            throwing_value::armed = false;
+
+            THEN("The lru cache is unchanged") {
+                CHECK(cache.size() == 2);
+                CHECK_FALSE(cache.contains(3));
+                CHECK(cache.get(1).text == "one");
+                CHECK(cache.get(2).text == "two");
+            }
+        }
+    }
+}
+
+// Puts items with keys 0 to 9 into a full cache with capacity = 3, whose values are vectors of 1000 - key elements, and
+// checks that each new value keeps the capacity of the value it is assigned to
+template <class LruCache>
+void check_recycled_values(LruCache& cache) {
+    for (int key = 0; key < 10; ++key) {
+        const typename LruCache::item_type item{key, std::vector<int>(static_cast<std::size_t>(1000 - key), key)};
+        cache.put(item);
+        CHECK(cache.get(key).size() == 1000u - static_cast<unsigned>(key));
+    }
+    CHECK(cache.size() == 3);
+    CHECK_FALSE(cache.contains(6));
+    CHECK(cache.get(7).size() == 993);
+    CHECK(cache.get(9).front() == 9);
+}
+
+SCENARIO("Reuse the least recent item when a full lru cache gets a new item", "[lru_cache_recycle]") {
+    GIVEN("Lru caches with key:int, value:std::vector<int> and capacity = 3") {
+        bjg::lru_cache<int, std::vector<int>> cache{3};
+        bjg::split_lru_cache<int, std::vector<int>> split_cache{3};
+        bjg::static_lru_cache<int, std::vector<int>, 3> static_cache;
+
+        THEN("The copies of the new values are moved into the evicted items") {
+            check_recycled_values(cache);
+            check_recycled_values(split_cache);
+            check_recycled_values(static_cache);
+        }
+    }
+
+    GIVEN("A full lru cache with key:std::string, value:std::string and capacity = 200") {
+        bjg::lru_cache<std::string, std::string> cache{200};
+        for (int i = 0; i < 200; ++i) cache.put(std::make_pair(std::to_string(i), std::string(50, 'x')));
+
+        WHEN("Many more items are put") {
+            for (int i = 200; i < 5000; ++i) {
+                cache.put(std::make_pair(std::to_string(i), std::to_string(i)));
+                const auto oldest = i - 199;
+                CHECK(*cache.peek(std::to_string(oldest)) == (oldest < 200 ? std::string(50, 'x') : std::to_string(oldest)));
+                CHECK_FALSE(cache.contains(std::to_string(i - 200)));
+            }
+
+            THEN("The lru cache holds exactly the most recent items") {
+                CHECK(cache.size() == 200);
+                for (int i = 4800; i < 5000; ++i) CHECK(cache.get(std::to_string(i)) == std::to_string(i));
+            }
+        }
+    }
+
+    GIVEN("Full lru caches with keys and values whose assignments cannot throw, and capacity = 100") {
+        bjg::lru_cache<int, int> cache{100};
+        bjg::lru_cache<int_wrapper, int> wrapper_cache{100, bjg::preallocate};
+        for (int i = 0; i < 100; ++i) {
+            cache.put(std::make_pair(i, i));
+            wrapper_cache.put(std::make_pair(int_wrapper{i}, i));
+        }
+
+        WHEN("Many more items are put, while some items are erased and put back") {
+            for (int i = 100; i < 20000; ++i) {
+                cache.put(std::make_pair(i, i));
+                wrapper_cache.put(std::make_pair(int_wrapper{i}, i));
+                if (i % 7 == 0 && i < 19000) {
+                    CHECK(cache.erase(i - 50));
+                    CHECK(wrapper_cache.erase(int_wrapper{i - 50}));
+                    cache.put(std::make_pair(i - 50, -i));
+                    wrapper_cache.put(std::make_pair(int_wrapper{i - 50}, -i));
+                    CHECK(*cache.peek(i - 50) == -i);
+                    CHECK(*wrapper_cache.peek(int_wrapper{i - 50}) == -i);
+                }
+            }
+
+            THEN("The recycled items are reindexed under their new keys") {
+                CHECK(cache.size() == 100);
+                CHECK(wrapper_cache.size() == 100);
+                for (int i = 19900; i < 20000; ++i) {
+                    CHECK(cache.get(i) == i);
+                    CHECK(wrapper_cache.get(int_wrapper{i}) == i);
+                }
+                CHECK_FALSE(cache.contains(19899));
+                CHECK_FALSE(wrapper_cache.contains(int_wrapper{19899}));
+            }
+        }
+    }
+
+    GIVEN("A full lru cache with key:int, value:throwing_value and capacity = 2") {
+        bjg::lru_cache<int, throwing_value> cache{2};
+        throwing_value::armed = false;
+        cache.put(std::make_pair(1, throwing_value{"one"}));
+        cache.put(std::make_pair(2, throwing_value{"two"}));
+
+        WHEN("Copying the value of a new item throws") {
+            const bjg::lru_cache<int, throwing_value>::item_type item{3, throwing_value{"three"}};
+            throwing_value::armed = true;
+            CHECK_THROWS_AS(cache.put(item), std::runtime_error);
+            throwing_value::armed = false;
+
+            THEN("The lru cache is unchanged") {
+                CHECK(cache.size() == 2);
+                CHECK_FALSE(cache.contains(3));
+                CHECK(cache.get(1).text == "one");
+                CHECK(cache.get(2).text == "two");
+                cache.put(item);
+                CHECK(cache.get(3).text == "three");
+                CHECK_FALSE(cache.contains(1));
+            }
+        }
+    }
+
+    GIVEN("A full lru cache with key:int, value:throwing_value, capacity = 4 and recency order 1, 4, 3, 2") {
+        bjg::lru_cache<int, throwing_value> cache{4};
+        throwing_value::armed = false;
+        for (int i = 1; i <= 4; ++i) cache.put(std::make_pair(i, throwing_value{std::to_string(i)}));
+        cache.get(1);
+
+        WHEN("Copying the value of a new item throws") {
+            const bjg::lru_cache<int, throwing_value>::item_type item{5, throwing_value{"5"}};
+            throwing_value::armed = true;
+            CHECK_THROWS_AS(cache.put(item), std::runtime_error);
+            throwing_value::armed = false;
+
+            THEN("All the items keep their values and recency order") {
+                CHECK(cache.size() == 4);
+                CHECK_FALSE(cache.contains(5));
+                CHECK(cache.peek(1)->text == "1");
+                CHECK(cache.peek(2)->text == "2");
+                CHECK(cache.peek(3)->text == "3");
+                CHECK(cache.peek(4)->text == "4");
+
+                cache.put(std::make_pair(6, throwing_value{"6"}));
+                CHECK_FALSE(cache.contains(2));
+                cache.put(std::make_pair(7, throwing_value{"7"}));
+                CHECK_FALSE(cache.contains(3));
+                CHECK(cache.contains(4));
+                cache.put(std::make_pair(8, throwing_value{"8"}));
+                CHECK_FALSE(cache.contains(4));
+                CHECK(cache.contains(1));
+                cache.put(std::make_pair(9, throwing_value{"9"}));
+                CHECK_FALSE(cache.contains(1));
+                CHECK(cache.size() == 4);
+            }
+        }
+    }
+
+    GIVEN("A full lru cache with key:int, value:movable_throwing_value and capacity = 2") {
+        bjg::lru_cache<int, movable_throwing_value> cache{2};
+        throwing_value::armed = false;
+        cache.put(std::make_pair(1, movable_throwing_value{"one"}));
+        cache.put(std::make_pair(2, movable_throwing_value{"two"}));
+
+        WHEN("Copying the value of a new item throws before it is moved into the least recent item") {
+            const bjg::lru_cache<int, movable_throwing_value>::item_type item{3, movable_throwing_value{"three"}};
+            throwing_value::armed = true;
+            CHECK_THROWS_AS(cache.put(item), std::runtime_error);
+            throwing_value::armed = false;
+
+            THEN("The lru cache is unchanged") {
+                CHECK(cache.size() == 2);
+                CHECK_FALSE(cache.contains(3));
+                CHECK(cache.peek(1)->text == "one");
+                CHECK(cache.peek(2)->text == "two");
+                cache.put(item);
+                CHECK(cache.get(3).text == "three");
+                CHECK_FALSE(cache.contains(1));
+            }
+        }
+    }
+}
+
+SCENARIO("Hash each key once while inserting and evicting items", "[lru_cache_hash_once]") {
+    GIVEN("An empty lru cache with key:counted_int, value:int, capacity = 100") {
+        using lru_cache_t = bjg::lru_cache<counted_int, int>;
+        lru_cache_t cache{100};
+        counted_int_hashes = 0;
+
+        WHEN("Many more items than the capacity are inserted") {
+            for (int i = 0; i < 1000; ++i) {
+                cache.put(std::make_pair(counted_int{i}, i));
+            }
+
+            THEN("Each key was hashed exactly once, despite the index growth and the evictions") {
+                CHECK(counted_int_hashes == 1000);
+                CHECK(cache.size() == 100);
+            }
+        }
+
+        WHEN("An existing item is updated") {
+            cache.put(std::make_pair(counted_int{1}, 1));
+            cache.put(std::make_pair(counted_int{2}, 2));
+            counted_int_hashes = 0;
+            counted_int_comparisons = 0;
+            cache.put(std::make_pair(counted_int{1}, 10));
+
+            THEN("The key was hashed and compared once") {
+                CHECK(counted_int_hashes == 1);
+                CHECK(counted_int_comparisons == 1);
+                CHECK(cache.get(counted_int{1}) == 10);
+            }
+        }
+
+        WHEN("Items are put, looked up and erased with hashes computed by the hash function of the lru cache") {
+            const auto hash_function = cache.hash_function();
+            std::vector<std::size_t> hashes;
+            for (int i = 0; i < 200; ++i) hashes.push_back(hash_function(counted_int{i}));
+            counted_int_hashes = 0;
+
+            for (int i = 0; i < 200; ++i) {
+                const auto index = static_cast<std::size_t>(i);
+                cache.put(std::make_pair(counted_int{i}, i), hashes[index]);
+                if (i % 2 == 0) cache.put(lru_cache_t::item_type{counted_int{i}, i + 1}, hashes[index]);
+            }
+            const auto found = cache.contains(counted_int{150}, hashes[150]) && !cache.contains(counted_int{50}, hashes[50]);
+            const auto value = cache.get(counted_int{150}, hashes[150]);
+            const auto* const tried = cache.try_get(counted_int{151}, hashes[151]);
+            const auto* const peeked = cache.peek(counted_int{152}, hashes[152]);
+            const auto erased = cache.erase(counted_int{153}, hashes[153]);
+
+            THEN("No key was hashed again") {
+                CHECK(counted_int_hashes == 0);
+                CHECK(found);
+                CHECK(value == 151);
+                CHECK(*tried == 151);
+                CHECK(*peeked == 153);
+                CHECK(erased);
+                CHECK(cache.size() == 99);
+                CHECK_THROWS_AS(cache.get(counted_int{50}, hashes[50]), std::out_of_range);
+                CHECK(cache.get(counted_int{199}) == 199);
+                CHECK(counted_int_hashes == 1);
+            }
+        }
+    }
+}
+
+SCENARIO("Reach items through stable handles", "[lru_cache_handles]") {
+    GIVEN("A lru cache with handles, key:counted_int, value:int, capacity = 3, holding two items reached by their handles") {
+        using lru_cache_t = bjg::handle_lru_cache<counted_int, int>;
+        lru_cache_t cache{3};
+        const auto first = cache.put(std::make_pair(counted_int{1}, 10));
+        const auto second = cache.put(std::make_pair(counted_int{2}, 20));
+
+        WHEN("The items are read, updated and touched through their handles") {
+            counted_int_hashes = 0;
+            counted_int_comparisons = 0;
+            const auto value = cache.get(first);
+            const auto updated = cache.update(first, [](int& stored) { stored += 1; });
+            const auto touched = cache.touch(second);
+
+            THEN("The keys are neither hashed nor compared, and the items are promoted") {
+                CHECK(value == 10);
+                CHECK(updated);
+                CHECK(touched);
+                CHECK(*cache.peek(first) == 11);
+                CHECK(*cache.try_get(second) == 20);
+                CHECK(cache.contains(first));
+                CHECK(counted_int_hashes == 0);
+                CHECK(counted_int_comparisons == 0);
+                cache.put(std::make_pair(counted_int{3}, 30));
+                cache.put(std::make_pair(counted_int{4}, 40));
+                CHECK_FALSE(cache.contains(counted_int{1}));
+                CHECK(cache.contains(second));
+            }
+        }
+
+        WHEN("The handles are found by key") {
+            const auto found = cache.find(counted_int{2});
+            const auto missing = cache.find(counted_int{5});
+
+            THEN("They reach the same items, or none") {
+                CHECK(found.index == second.index);
+                CHECK(cache.get(found) == 20);
+                CHECK(first);
+                CHECK_FALSE(missing);
+                CHECK_FALSE(lru_cache_t::handle{});
+                CHECK(cache.try_get(missing) == nullptr);
+                CHECK_FALSE(cache.contains(lru_cache_t::handle{}));
+            }
+        }
+
+        WHEN("An item is erased and another one is evicted, so their nodes are reused") {
+            cache.erase(counted_int{1});
+            cache.put(std::make_pair(counted_int{3}, 30));
+            cache.put(std::make_pair(counted_int{4}, 40));
+            const auto fifth = cache.put(std::make_pair(counted_int{5}, 50));
+
+            THEN("Their handles are stale") {
+                CHECK_FALSE(cache.contains(first));
+                CHECK_FALSE(cache.contains(second));
+                CHECK(cache.try_get(first) == nullptr);
+                CHECK(cache.peek(second) == nullptr);
+                CHECK_THROWS_AS(cache.get(first), std::out_of_range);
+                CHECK_FALSE(cache.update(second, [](int& stored) { stored = 0; }));
+                CHECK_FALSE(cache.touch(first));
+                CHECK(cache.get(fifth) == 50);
+                CHECK(cache.get(counted_int{3}) == 30);
+            }
+        }
+
+        WHEN("The lru cache is cleared and refilled") {
+            cache.clear();
+            const auto third = cache.put(std::make_pair(counted_int{3}, 30));
+            const auto fourth = cache.put(std::make_pair(counted_int{4}, 40));
+
+            THEN("The handles taken before the clear are stale, even though their nodes are reused") {
+                CHECK_FALSE(cache.contains(first));
+                CHECK_FALSE(cache.contains(second));
+                CHECK(cache.get(third) == 30);
+                CHECK(cache.get(fourth) == 40);
+            }
+        }
+
+        WHEN("The lru cache is copied, and another lru cache is assigned to it") {
+            const lru_cache_t copy{cache};
+            lru_cache_t other{3};
+            const auto other_first = other.put(std::make_pair(counted_int{7}, 70));
+            other = cache;
+
+            THEN("The copy accepts the handles of its source, the assigned lru cache accepts no former handle") {
+                CHECK(*copy.peek(first) == 10);
+                CHECK(*copy.peek(second) == 20);
+                CHECK_FALSE(other.contains(other_first));
+                CHECK_FALSE(other.contains(first));
+                CHECK(other.get(counted_int{1}) == 10);
+                CHECK(cache.get(first) == 10);
+            }
+        }
+    }
+
+    GIVEN("Lru caches with key:int, value:int, with and without handles") {
+        using plain_cache_t = bjg::compact_lru_cache<int, int, 1000>;
+        using handle_cache_t = bjg::handle_lru_cache<int, int, std::hash<int>, std::equal_to<int>,
+                                                     std::allocator<std::pair<const int, int>>, 1000>;
+
+        THEN("Only the lru caches with handles return them from put and keep a generation per item") {
+            CHECK(std::is_void<decltype(std::declval<plain_cache_t&>().put(std::make_pair(1, 1)))>::value);
+            CHECK(std::is_same<decltype(std::declval<handle_cache_t&>().put(std::make_pair(1, 1))),
+                               handle_cache_t::handle>::value);
+            CHECK(sizeof(bjg::static_lru_cache<int, int, 100>) + 4 * 100 <=
+                  sizeof(bjg::static_lru_cache<int, int, 100, std::hash<int>, std::equal_to<int>, true>));
+        }
+    }
+}
+
+SCENARIO("Store each key once", "[lru_cache_key_copies]") {
+    GIVEN("An empty lru cache with key:copy_counted_key, value:int, capacity = 100") {
+        using lru_cache_t = bjg::lru_cache<copy_counted_key, int>;
+        lru_cache_t cache{100};
+        const lru_cache_t::item_type item{copy_counted_key{1}, 1};
+        copy_counted_key::copies = 0;
+
+        WHEN("An item is inserted") {
+            cache.put(item);
+
+            THEN("Its key is copied only into the stored item") { CHECK(copy_counted_key::copies == 1); }
+        }
+    }
+}
+
+// Puts, emplaces and updates move-only values in a cache with key:int, value:std::unique_ptr<int> and capacity = 2
+template <class LruCache>
+void check_move_only_values(LruCache& cache) {
+    cache.put(std::make_pair(1, std::unique_ptr<int>{new int{1}}));
+    CHECK(cache.emplace(2, new int{2}));
+    std::unique_ptr<int> unused{new int{10}};
+    CHECK_FALSE(cache.try_emplace(1, std::move(unused)));
+    CHECK(unused != nullptr);
+    CHECK(*cache.get(1) == 1);
+
+    CHECK_FALSE(cache.emplace(2, new int{20}));
+    CHECK(*cache.get(2) == 20);
+    cache.put(std::make_pair(3, std::unique_ptr<int>{new int{3}}));
+    CHECK_FALSE(cache.contains(1));
+    CHECK(*cache.get(3) == 3);
+    CHECK(cache.size() == 2);
+}
+
+SCENARIO("Move items and construct values in place", "[lru_cache_move_emplace]") {
+    GIVEN("Lru caches with key:int, value:std::unique_ptr<int> and capacity = 2") {
+        bjg::lru_cache<int, std::unique_ptr<int>> cache{2};
+        bjg::split_lru_cache<int, std::unique_ptr<int>> split_cache{2};
+        bjg::compact_lru_cache<int, std::unique_ptr<int>, 100> compact_cache{2};
+
+        THEN("Move-only values are put, emplaced and updated") {
+            check_move_only_values(cache);
+            check_move_only_values(split_cache);
+            check_move_only_values(compact_cache);
+        }
+
+        WHEN("The cache is grown and moved") {
+            bjg::lru_cache<int, std::unique_ptr<int>> large_cache{100};
+            for (int i = 0; i < 100; ++i) large_cache.emplace(i, new int{i});
+            auto moved = std::move(large_cache);
+
+            THEN("The values are moved with their items") {
+                CHECK(moved.size() == 100);
+                CHECK(*moved.get(0) == 0);
+                CHECK(*moved.get(99) == 99);
+            }
+        }
+    }
+
+    GIVEN("Lru caches with key:std::string, value:counted_value and capacity = 2") {
+        bjg::lru_cache<std::string, counted_value> cache{2};
+        bjg::split_lru_cache<std::string, counted_value> split_cache{2};
+        counted_value::reset();
+
+        WHEN("Values are emplaced") {
+            cache.emplace("one", 1, 1);
+            split_cache.emplace("one", 1, 1);
+
+            THEN("They are constructed in place") {
+                CHECK(counted_value::constructions == 2);
+                CHECK(counted_value::copies == 0);
+                CHECK(counted_value::moves == 0);
+                CHECK(cache.get("one").second == 1);
+                CHECK(split_cache.get("one").second == 1);
+            }
+        }
+
+        WHEN("Values are emplaced with existing keys") {
+            cache.emplace("one", 1, 1);
+            cache.emplace("two", 2, 2);
+            counted_value::reset();
+            CHECK_FALSE(cache.try_emplace("one", 10, 10));
+            const auto kept_value = cache.peek("one")->first;
+            CHECK_FALSE(cache.emplace("two", 20, 20));
+            cache.emplace("three", 3, 3);
+
+            THEN("try_emplace constructs no value, emplace replaces the value and both promote their item") {
+                CHECK(counted_value::constructions == 2);
+                CHECK(counted_value::copies == 0);
+                CHECK(kept_value == 1);
+                CHECK_FALSE(cache.contains("one"));
+                CHECK(cache.get("two").first == 20);
+                CHECK(cache.contains("three"));
+            }
+        }
+
+        WHEN("An item is moved into the cache") {
+            cache.put(std::make_pair(std::string{"one"}, counted_value{1, 1}));
+            split_cache.put(bjg::split_lru_cache<std::string, counted_value>::item_type{"one", counted_value{1, 1}});
+
+            THEN("Its value is never copied") {
+                CHECK(counted_value::copies == 0);
+                CHECK(cache.contains("one"));
+                CHECK(split_cache.contains("one"));
+            }
+        }
+    }
+
+    GIVEN("A full lru cache with key:int, value:throwing_value and capacity = 2") {
+        bjg::lru_cache<int, throwing_value> cache{2};
+        throwing_value::armed = false;
+        cache.emplace(1, "one");
+        cache.emplace(2, "two");
+        const throwing_value value{"new"};
+
+        WHEN("Copying the value of an emplaced item throws") {
+            throwing_value::armed = true;
+            CHECK_THROWS_AS(cache.emplace(3, value), std::runtime_error);
+            CHECK_THROWS_AS(cache.emplace(1, value), std::runtime_error);
+            CHECK_THROWS_AS(cache.try_emplace(4, value), std::runtime_error);
+            throwing_value::armed = false;
+            cache.emplace(5, "five");
+
+            THEN("The cache is unchanged, even the recency of the updated item") {
+                CHECK(cache.size() == 2);
+                CHECK_FALSE(cache.contains(1));
+                CHECK(cache.get(2).text == "two");
+                CHECK_FALSE(cache.contains(3));
+                CHECK_FALSE(cache.contains(4));
+            }
+        }
+
+        WHEN("Swapping the new value of an emplaced item in throws") {
+            throwing_value::armed = true;
+            CHECK_THROWS_AS(cache.emplace(1, "uno"), std::runtime_error);
+            throwing_value::armed = false;
+            cache.emplace(5, "five");
+
+            THEN("The item keeps its value and its recency") {
+                CHECK(cache.size() == 2);
+                CHECK_FALSE(cache.contains(1));
+                CHECK(cache.get(2).text == "two");
+                CHECK(cache.get(5).text == "five");
+            }
+        }
+    }
+}
+
+SCENARIO("Update values in place", "[lru_cache_update_upsert]") {
+    GIVEN("A lru cache with key:std::string, value:counted_value, capacity = 2, holding two items") {
+        bjg::lru_cache<std::string, counted_value> cache{2};
+        cache.emplace("one", 1, 0);
+        cache.emplace("two", 2, 0);
+        counted_value::reset();
+
+        WHEN("An existing value is updated") {
+            const auto updated = cache.update("one", [](counted_value& value) { ++value.second; });
+            cache.emplace("three", 3, 0);
+
+            THEN("It is modified in place and its item is promoted") {
+                CHECK(updated);
+                CHECK(counted_value::constructions == 1);
+                CHECK(counted_value::copies + counted_value::moves == 0);
+                CHECK(cache.get("one").second == 1);
+                CHECK_FALSE(cache.contains("two"));
+            }
+        }
+
+        WHEN("A missing value is updated") {
+            bool called = false;
+            const auto updated = cache.update("three", [&called](counted_value&) { called = true; });
+
+            THEN("Nothing happens") {
+                CHECK_FALSE(updated);
+                CHECK_FALSE(called);
+                CHECK(cache.size() == 2);
+            }
+        }
+
+        WHEN("Items are counted with upsert") {
+            const auto make = []() { return counted_value{0, 1}; };
+            const auto increment = [](counted_value& value) { ++value.second; };
+            CHECK_FALSE(cache.upsert("one", make, increment));
+            CHECK(cache.upsert("three", make, increment));
+            CHECK_FALSE(cache.upsert("three", make, increment));
+
+            THEN("Existing values are incremented and missing ones are made") {
+                CHECK(cache.size() == 2);
+                CHECK(cache.get("one").second == 1);
+                CHECK(cache.get("three").second == 2);
+                CHECK_FALSE(cache.contains("two"));
+            }
+        }
+
+        WHEN("The update function throws") {
+            CHECK_THROWS_AS(cache.update("one", [](counted_value&) { throw std::runtime_error{"update failed"}; }),
+                            std::runtime_error);
+            cache.emplace("three", 3, 0);
+
+            THEN("The item is not promoted") {
+                CHECK_FALSE(cache.contains("one"));
+                CHECK(cache.contains("two"));
+            }
+        }
+
+        WHEN("The make function of a new item throws") {
+            CHECK_THROWS_AS(
+                cache.upsert(
+                    "three", []() -> counted_value { throw std::runtime_error{"make failed"}; }, [](counted_value&) {}),
+                std::runtime_error);
+
+            THEN("The cache is unchanged") {
+                CHECK(cache.size() == 2);
+                CHECK(cache.contains("one"));
+                CHECK(cache.contains("two"));
+                CHECK_FALSE(cache.contains("three"));
+            }
+        }
+    }
+
+    GIVEN("A split lru cache with key:int, value:std::vector<int> and capacity = 10") {
+        bjg::split_lru_cache<int, std::vector<int>> cache{10};
+
+        WHEN("Values are appended to with upsert") {
+            for (int i = 0; i < 30; ++i) {
+                cache.upsert(
+                    i % 5, [i]() { return std::vector<int>{i}; }, [i](std::vector<int>& values) { values.push_back(i); });
+            }
+
+            THEN("Each value holds all its appended elements") {
+                CHECK(cache.size() == 5);
+                CHECK(cache.get(0) == (std::vector<int>{0, 5, 10, 15, 20, 25}));
+                CHECK(cache.get(4) == (std::vector<int>{4, 9, 14, 19, 24, 29}));
+            }
+        }
+    }
+}
+
+SCENARIO("Look up items without throwing", "[lru_cache_try_get_peek]") {
+    GIVEN("A lru cache with key:int_wrapper, value:std::string, size = 3 and capacity = 3") {
+        using lru_cache_t = bjg::lru_cache<int_wrapper, std::string>;
+        lru_cache_t cache{3};
+
+        cache.put(std::make_pair(int_wrapper{1}, "one"));
+        cache.put(std::make_pair(int_wrapper{2}, "two"));
+        cache.put(std::make_pair(int_wrapper{3}, "three"));
+
+        WHEN("Missing keys are looked up") {
+            THEN("try_get and peek return nullptr") {
+                CHECK(cache.try_get(int_wrapper{4}) == nullptr);
+                CHECK(cache.peek(int_wrapper{4}) == nullptr);
+            }
+        }
+
+        WHEN("The least recent item is read with try_get and a new item is added") {
+            const auto value = cache.try_get(int_wrapper{1});
+            REQUIRE(value != nullptr);
+            CHECK(*value == "one");
+            cache.put(std::make_pair(int_wrapper{4}, "four"));
+
+            THEN("The item read was promoted and the next least recent item is evicted") {
+                CHECK(cache.contains(int_wrapper{1}));
+                CHECK_FALSE(cache.contains(int_wrapper{2}));
+            }
+        }
+
+        WHEN("The least recent item is read with peek and a new item is added") {
+            const auto& const_cache = cache;
+            const auto value = const_cache.peek(int_wrapper{1});
+            REQUIRE(value != nullptr);
+            CHECK(*value == "one");
+            cache.put(std::make_pair(int_wrapper{4}, "four"));
+
+            THEN("The item read was not promoted and is evicted") {
+                CHECK_FALSE(cache.contains(int_wrapper{1}));
+                CHECK(cache.contains(int_wrapper{2}));
+            }
+        }
+    }
+}
+
+SCENARIO("Allocate the lru cache storage through a custom allocator", "[lru_cache_allocator]") {
+    GIVEN("A lru cache with key:int, value:std::string, capacity = 50 and a counting allocator") {
+        using allocator_t = counting_allocator<std::pair<const int, std::string>>;
+        using lru_cache_t = bjg::lru_cache<int, std::string, std::hash<int>, std::equal_to<int>, allocator_t>;
+        allocation_counters counters;
+
+        WHEN("Items are inserted until some are evicted") {
+            {
+                lru_cache_t cache{50, allocator_t{&counters}};
+                for (int i = 0; i < 100; ++i) cache.put(std::make_pair(i, std::to_string(i)));
+
+                THEN("The storage is allocated through the allocator") {
+                    CHECK(cache.get_allocator() == allocator_t{&counters});
+                    CHECK(counters.allocations > 0);
+                    CHECK(cache.size() == 50);
+                    CHECK(cache.get(99) == "99");
+                }
+            }
+
+            THEN("All the storage is released through the allocator") { CHECK(counters.live_blocks == 0); }
+        }
+
+        WHEN("A cache is copied and moved into caches using other allocators") {
+            allocation_counters other_counters;
+            lru_cache_t cache{50, bjg::preallocate, allocator_t{&counters}};
+            for (int i = 0; i < 10; ++i) cache.put(std::make_pair(i, std::to_string(i)));
+
+            const lru_cache_t copy{cache};
+            lru_cache_t moved{50, allocator_t{&other_counters}};
+            moved = std::move(cache);
+
+            THEN("The copy shares the allocator and the moved-to cache keeps its own") {
+                CHECK(copy.get_allocator() == allocator_t{&counters});
+                CHECK(moved.get_allocator() == allocator_t{&other_counters});
+                CHECK(other_counters.live_blocks > 0);
+                CHECK(copy.peek(0) != nullptr);
+                CHECK(*moved.peek(9) == "9");
+                CHECK(moved.size() == 10);
+            }
+        }
+    }
+}
+
+SCENARIO("Create a lru cache reporting errors instead of throwing them", "[lru_cache_create]") {
+    GIVEN("Lru cache types with key:int, value:std::string and a counting allocator") {
+        using allocator_t = counting_allocator<std::pair<const int, std::string>>;
+        using lru_cache_t = bjg::lru_cache<int, std::string, std::hash<int>, std::equal_to<int>, allocator_t>;
+        using split_cache_t =
+            bjg::split_lru_cache<std::string, std::string, std::hash<std::string>, std::equal_to<std::string>,
+                                 counting_allocator<std::pair<const std::string, std::string>>>;
+        using compact_cache_t = bjg::compact_lru_cache<int, std::string, 100>;
+        allocation_counters counters;
+
+        WHEN("Lru caches are created with valid capacities") {
+            auto created = lru_cache_t::create(50, allocator_t{&counters});
+            const auto allocations = counters.allocations;
+            REQUIRE(created);
+            for (int i = 0; i < 100; ++i) created->put(std::make_pair(i, std::to_string(i)));
+            lru_cache_t cache{std::move(*created)};
+
+            THEN("Their storage is allocated up front") {
+                CHECK(allocations == 2);
+                CHECK(counters.allocations == allocations);
+                CHECK(cache.size() == 50);
+                REQUIRE(cache.try_get(99) != nullptr);
+                CHECK(*cache.try_get(99) == "99");
+                CHECK(cache.try_get(49) == nullptr);
+                CHECK(compact_cache_t::create(100));
+            }
+        }
+
+        WHEN("Lru caches are created with invalid capacities") {
+            const auto empty = lru_cache_t::create(0, allocator_t{&counters});
+            const auto too_large = compact_cache_t::create(101);
+            const auto unaddressable = lru_cache_t::create(static_cast<std::size_t>(-1), allocator_t{&counters});
+
+            THEN("The errors are reported and nothing is allocated") {
+                CHECK_FALSE(empty);
+                CHECK(empty.error() == bjg::cache_errc::invalid_capacity);
+                CHECK_FALSE(too_large);
+                CHECK(too_large.error() == bjg::cache_errc::invalid_capacity);
+                CHECK_FALSE(unaddressable);
+                CHECK(unaddressable.error() == bjg::cache_errc::invalid_capacity);
+                CHECK(counters.allocations == 0);
+            }
+        }
+
+        WHEN("The allocator returns nullptr for the storage of the items or of their index") {
+            counters.allocation_limit = counters.allocations;
+            const auto no_items = lru_cache_t::create(50, allocator_t{&counters});
+            counters.allocation_limit = counters.allocations + 1;
+            const auto no_values = split_cache_t::create(50, split_cache_t::allocator_type{&counters});
+            counters.allocation_limit = counters.allocations + 2;
+            const auto no_index = split_cache_t::create(50, split_cache_t::allocator_type{&counters});
+
+            THEN("The errors are reported and the allocated storage is released") {
+                CHECK(no_items.error() == bjg::cache_errc::out_of_memory);
+                CHECK(no_values.error() == bjg::cache_errc::out_of_memory);
+                CHECK(no_index.error() == bjg::cache_errc::out_of_memory);
+                CHECK(counters.live_blocks == 0);
+            }
+        }
+
+        WHEN("The allocator returns nullptr while a lru cache created by its constructor grows") {
+            lru_cache_t cache{50, allocator_t{&counters}};
+            cache.put(std::make_pair(1, "one"));
+            counters.allocation_limit = counters.allocations;
+            std::size_t size = 1;
+            const auto fill = [&cache, &size]() {
+                for (; size < 50; ++size) cache.put(std::make_pair(static_cast<int>(size) + 1, "more"));
+            };
+
+            THEN("The growth raises std::bad_alloc and the lru cache keeps its items") {
+                CHECK_THROWS_AS(fill(), std::bad_alloc);
+                CHECK(cache.size() == size);
+                CHECK_FALSE(cache.contains(static_cast<int>(size) + 1));
+                CHECK(cache.get(1) == "one");
+            }
+        }
+    }
+
+    GIVEN("A lru cache with key:int, value:int and a nothrow allocator, created with capacity = 100") {
+        auto created = bjg::lru_cache<int, int, std::hash<int>, std::equal_to<int>,
+                                      bjg::nothrow_allocator<std::pair<const int, int>>>::create(100);
+        REQUIRE(created);
+
+        WHEN("Many items are put") {
+            for (int i = 0; i < 1000; ++i) created->put(std::make_pair(i, i * 2));
+
+            THEN("It holds the most recent items") {
+                CHECK(created->size() == 100);
+                REQUIRE(created->peek(999) != nullptr);
+                CHECK(*created->peek(999) == 1998);
+                CHECK_FALSE(created->contains(899));
+            }
+        }
+    }
+}
+
+#ifdef BJG_LRU_CACHE_HAVE_PMR
+SCENARIO("Allocate the lru cache storage from a memory resource", "[lru_cache_pmr]") {
+    GIVEN("A pmr lru cache with key:int, value:std::pmr::string and capacity = 100, backed by a monotonic buffer") {
+        std::pmr::monotonic_buffer_resource buffer_resource{1 << 16, std::pmr::new_delete_resource()};
+        bjg::pmr::lru_cache<int, std::pmr::string> cache{100, &buffer_resource};
+
+        WHEN("Items are inserted until some are evicted") {
+            for (int i = 0; i < 200; ++i) {
+                cache.put(std::make_pair(i, std::pmr::string{"a value which does not fit the small string buffer"}));
+            }
+
+            THEN("The items and their values are allocated from the resource") {
+                CHECK(cache.get_allocator().resource() == &buffer_resource);
+                CHECK(cache.size() == 100);
+                REQUIRE(cache.peek(199) != nullptr);
+                CHECK(cache.peek(199)->get_allocator().resource() == &buffer_resource);
+            }
+        }
+    }
+}
+#endif
+
+SCENARIO("Erase items from the lru cache", "[lru_cache_erase]") {
+    GIVEN("A lru cache with key:int_wrapper, value:std::string, size = 3 and capacity = 3") {
+        using lru_cache_t = bjg::lru_cache<int_wrapper, std::string>;
+        lru_cache_t cache{3};
+
+        cache.put(std::make_pair(int_wrapper{1}, "one"));
+        cache.put(std::make_pair(int_wrapper{2}, "two"));
+        cache.put(std::make_pair(int_wrapper{3}, "three"));
+
+        WHEN("A missing key is erased") {
+            THEN("Nothing is removed") {
+                CHECK_FALSE(cache.erase(int_wrapper{4}));
+                CHECK(cache.size() == 3);
+            }
+        }
+
+        WHEN("The least recent item is erased and two new items are added") {
+            CHECK(cache.erase(int_wrapper{1}));
+            cache.put(std::make_pair(int_wrapper{4}, "four"));
+            cache.put(std::make_pair(int_wrapper{5}, "five"));
+
+            THEN("The erased item is gone and the next least recent item is evicted") {
+                CHECK(cache.size() == 3);
+                CHECK_FALSE(cache.contains(int_wrapper{1}));
+                CHECK_FALSE(cache.contains(int_wrapper{2}));
+                CHECK(cache.get(int_wrapper{3}) == "three");
+                CHECK(cache.get(int_wrapper{5}) == "five");
+            }
+        }
+
+        WHEN("All the items are erased") {
+            CHECK(cache.erase(int_wrapper{2}));
+            CHECK(cache.erase(int_wrapper{3}));
+            CHECK(cache.erase(int_wrapper{1}));
+
+            THEN("The lru cache is empty and can be filled again") {
+                CHECK(cache.empty());
+                cache.put(std::make_pair(int_wrapper{6}, "six"));
+                CHECK(cache.get(int_wrapper{6}) == "six");
+            }
+        }
+    }
+}
+
+template <class Cache>
+void check_lazy_clear(Cache& cache) {
+    for (int i = 0; i < 10; ++i) cache.put(std::make_pair(i, live_value{i}));
+    REQUIRE(live_value::count == 10);
+
+    cache.clear();
+    CHECK(cache.empty());
+    CHECK_FALSE(cache.contains(3));
+    CHECK(cache.try_get(3) == nullptr);
+    CHECK(live_value::count == 10);
+
+    for (int i = 20; i < 24; ++i) cache.put(std::make_pair(i, live_value{i}));
+    CHECK(cache.size() == 4);
+    CHECK(live_value::count == 10);
+    CHECK(cache.get(21).value == 21);
+    CHECK_FALSE(cache.contains(1));
+
+    {
+        Cache copy{cache};
+        CHECK(copy.size() == 4);
+        CHECK(live_value::count == 14);
+        CHECK(copy.get(22).value == 22);
+    }
+    CHECK(live_value::count == 10);
+
+    cache.clear();
+    for (int i = 30; i < 45; ++i) cache.put(std::make_pair(i, live_value{i}));
+    CHECK(cache.size() == 10);
+    CHECK(live_value::count == 10);
+    for (int i = 35; i < 45; ++i) CHECK(cache.get(i).value == i);
+
+    Cache moved{std::move(cache)};
+    CHECK(moved.size() == 10);
+    cache = moved;
+    CHECK(cache.get(40).value == 40);
+    moved.clear();
+    cache.clear();
+}
+
+SCENARIO("Clear a lru cache without destroying its items right away", "[lru_cache_clear]") {
+    GIVEN("A lru cache with key:int, value:live_value, capacity = 10") {
+        bjg::lru_cache<int, live_value> cache{10};
+
+        WHEN("It is cleared, refilled, copied and moved") {
+            THEN("The cleared items are destroyed by later insertions or with the lru cache") { check_lazy_clear(cache); }
+        }
+    }
+
+    GIVEN("A split lru cache with key:int, value:live_value, capacity = 10") {
+        bjg::split_lru_cache<int, live_value> cache{10};
+
+        WHEN("It is cleared, refilled, copied and moved") {
+            THEN("The cleared items are destroyed by later insertions or with the lru cache") { check_lazy_clear(cache); }
+        }
+    }
+
+    GIVEN("A lru cache cleared while it holds items") {
+        {
+            bjg::lru_cache<int, live_value> cache{10};
+            for (int i = 0; i < 8; ++i) cache.put(std::make_pair(i, live_value{i}));
+            cache.clear();
+            cache.put(std::make_pair(100, live_value{100}));
+            CHECK(live_value::count == 8);
+        }
+
+        THEN("Its destruction destroys the cleared items") { CHECK(live_value::count == 0); }
+    }
+
+    GIVEN("A compact lru cache with key:int, value:int, capacity = 50, whose 16 bit index epoch wraps around") {
+        bjg::compact_lru_cache<int, int, 100> cache{50};
+
+        WHEN("It is cleared many more times than its index has epochs, and its items are erased and evicted in between") {
+            bool consistent = true;
+            for (int round = 0; round < 70000; ++round) {
+                const auto first = (round % 7) * 10;
+                for (int i = first; i < first + 60; ++i) cache.put(std::make_pair(i, round));
+                consistent = consistent && cache.erase(first + 30) && !cache.contains(first + 30) &&
+                             !cache.contains(first + 9) && cache.size() == 49 && *cache.peek(first + 59) == round;
+                cache.clear();
+                consistent = consistent && !cache.contains(first + 59) && cache.empty();
+            }
+
+            THEN("The keys of earlier epochs are never found") {
+                CHECK(consistent);
+                cache.put(std::make_pair(1, 1));
+                CHECK(cache.get(1) == 1);
+                CHECK_FALSE(cache.contains(2));
+            }
+        }
+    }
+}
+
+template <class Cache>
+void check_graveyard(Cache& cache) {
+    cache.set_graveyard_capacity(5);
+    for (int i = 0; i < 13; ++i) cache.put(std::make_pair(i, live_value{i}));
+    CHECK(cache.size() == 10);
+    CHECK_FALSE(cache.contains(2));
+    CHECK(cache.graveyard_size() == 3);
+    CHECK(live_value::count == 13);
+
+    CHECK(cache.reclaim(2) == 2);
+    CHECK(cache.graveyard_size() == 1);
+    CHECK(live_value::count == 11);
+
+    for (int i = 13; i < 21; ++i) cache.put(std::make_pair(i, live_value{i}));
+    CHECK(cache.graveyard_size() == 5);
+    CHECK(live_value::count == 15);
+    CHECK(cache.reclaim(100) == 5);
+    CHECK(live_value::count == 10);
+    for (int i = 11; i < 21; ++i) CHECK(cache.get(i).value == i);
+
+    cache.clear();
+    cache.put(std::make_pair(30, live_value{30}));
+    CHECK(cache.graveyard_size() == 9);
+    CHECK(live_value::count == 10);
+
+    cache.set_graveyard_capacity(2);
+    CHECK(cache.graveyard_size() == 2);
+    CHECK(live_value::count == 3);
+
+    cache.set_graveyard_capacity(0);
+    for (int i = 31; i < 41; ++i) cache.put(std::make_pair(i, live_value{i}));
+    CHECK(cache.size() == 10);
+    CHECK(cache.graveyard_size() == 0);
+    CHECK(cache.reclaim(1) == 0);
+    CHECK(live_value::count == 10);
+    cache.clear();
+}
+
+SCENARIO("Defer the destruction of evicted items to reclaim", "[lru_cache_graveyard]") {
+    GIVEN("A lru cache with key:int, value:live_value, capacity = 10") {
+        bjg::lru_cache<int, live_value> cache{10};
+
+        WHEN("Items are evicted into a graveyard of 5 items, then reclaimed") {
+            THEN("The graveyard holds the evicted items until reclaim or a full graveyard destroys them") {
+                check_graveyard(cache);
+            }
+        }
+    }
+
+    GIVEN("A split lru cache with key:int, value:live_value, capacity = 10") {
+        bjg::split_lru_cache<int, live_value> cache{10};
+
+        WHEN("Items are evicted into a graveyard of 5 items, then reclaimed") {
+            THEN("The graveyard holds the evicted items until reclaim or a full graveyard destroys them") {
+                check_graveyard(cache);
+            }
+        }
+    }
+
+    GIVEN("A compact lru cache with key:int, value:int, capacity = 1000 and 16 bit links") {
+        bjg::compact_lru_cache<int, int, 1000> cache{1000};
+
+        THEN("Its graveyard cannot hold more items than its links can address") {
+            CHECK_THROWS_AS(cache.set_graveyard_capacity(70000), std::length_error);
+            CHECK_THROWS_AS(cache.set_graveyard_capacity(static_cast<std::size_t>(-1)), std::length_error);
+            cache.set_graveyard_capacity(100);
+            for (int i = 0; i < 1200; ++i) cache.put(std::make_pair(i, i));
+            CHECK(cache.graveyard_size() == 100);
+            CHECK(cache.get(1199) == 1199);
+        }
+    }
+}
+
+// Checks that batched lookups and puts leave the same items, in the same recency order, as one by one lookups and puts
+template <class Cache, class MakeKey>
+void check_batches(Cache& cache, MakeKey make_key) {
+    using item_t = std::pair<typename std::decay<decltype(make_key(0))>::type, int>;
+    std::vector<item_t> items;
+    for (int i = 0; i < 150; ++i) items.emplace_back(make_key(i), i);
+
+    Cache reference{cache};
+    cache.multi_put(items.begin(), items.end());
+    for (const auto& item : items) reference.put(item);
+    REQUIRE(cache.size() == 100);
+
+    std::vector<typename item_t::first_type> keys;
+    for (int i = 0; i < 150; i += 3) keys.push_back(make_key(i));
+    keys.push_back(make_key(140));
+    std::vector<const int*> values;
+    cache.multi_get(keys.begin(), keys.end(), std::back_inserter(values));
+
+    REQUIRE(values.size() == keys.size());
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        const auto* const expected = reference.try_get(keys[i]);
+        CHECK((values[i] == nullptr) == (expected == nullptr));
+        if (values[i] != nullptr && expected != nullptr) CHECK(*values[i] == *expected);
+    }
+
+    std::vector<item_t> more_items;
+    for (int i = 1000; i < 1090; ++i) more_items.emplace_back(make_key(i), i);
+    cache.multi_put(std::make_move_iterator(more_items.begin()), std::make_move_iterator(more_items.end()));
+    for (int i = 1000; i < 1090; ++i) reference.put(std::make_pair(make_key(i), i));
+
+    CHECK(cache.size() == reference.size());
+    for (int i = 0; i < 150; ++i) CHECK(cache.contains(make_key(i)) == reference.contains(make_key(i)));
+    for (int i = 1000; i < 1090; ++i) CHECK(cache.get(make_key(i)) == i);
+}
+
+int same_key(const int key) { return key; }
+
+std::string string_key(const int key) { return "key " + std::to_string(key); }
+
+SCENARIO("Look up and put batches of items", "[lru_cache_batches]") {
+    GIVEN("A lru cache with key:int, value:int, capacity = 100") {
+        bjg::lru_cache<int, int> cache{100};
+
+        WHEN("Batches of items are put and looked up") {
+            THEN("The lru cache holds the same items as with one by one operations") { check_batches(cache, same_key); }
+        }
+    }
+
+    GIVEN("A lru cache with key:std::string, value:int, capacity = 100") {
+        bjg::lru_cache<std::string, int> cache{100};
+
+        WHEN("Batches of items are put and looked up") {
+            THEN("The lru cache holds the same items as with one by one operations") { check_batches(cache, string_key); }
+        }
+    }
+
+    GIVEN("A split lru cache with key:std::string, value:int, capacity = 100") {
+        bjg::split_lru_cache<std::string, int> cache{100};
+
+        WHEN("Batches of items are put and looked up") {
+            THEN("The lru cache holds the same items as with one by one operations") { check_batches(cache, string_key); }
+        }
+    }
+
+    GIVEN("An empty lru cache with key:int, value:std::unique_ptr<int>, capacity = 2") {
+        bjg::lru_cache<int, std::unique_ptr<int>> cache{2};
+        std::vector<std::pair<const int, std::unique_ptr<int>>> items;
+        for (int i = 0; i < 3; ++i) items.emplace_back(i, std::unique_ptr<int>{new int{i}});
+        const std::vector<int> keys{0, 1, 2};
+        std::vector<const std::unique_ptr<int>*> values(3);
+
+        WHEN("Move-only values are moved into it, then looked up") {
+            cache.multi_put(std::make_move_iterator(items.begin()), std::make_move_iterator(items.end()));
+            const auto end = cache.multi_get(keys.begin(), keys.end(), values.begin());
+
+            THEN("The least recent item is evicted and the other values are found") {
+                CHECK(end == values.end());
+                CHECK(values[0] == nullptr);
+                CHECK(**values[1] == 1);
+                CHECK(**values[2] == 2);
+                CHECK(items[2].second == nullptr);
+            }
+        }
+    }
+}
+
+SCENARIO("Look up string keys by C strings", "[lru_cache_transparent_lookup]") {
+    GIVEN("A lru cache with key:std::string, value:int, transparent hash and equality and capacity = 2") {
+        using lru_cache_t = bjg::lru_cache<std::string, int, transparent_string_hash, transparent_string_equal>;
+        lru_cache_t cache{2};
+
+        cache.put(std::make_pair(std::string{"one"}, 1));
+        cache.put(std::make_pair(std::string{"two"}, 2));
+
+        WHEN("Items are looked up by C strings") {
+            THEN("They are found as if looked up by std::string") {
+                CHECK(cache.get("one") == 1);
+                CHECK(*cache.try_get("two") == 2);
+                CHECK(*cache.peek("one") == 1);
+                CHECK(cache.contains("one"));
+                CHECK_FALSE(cache.contains("three"));
+                CHECK(cache.try_get("three") == nullptr);
+                CHECK_THROWS_AS(cache.get("three"), std::out_of_range);
+            }
+        }
+
+        WHEN("The least recent item is promoted by a C string lookup and a new item is added") {
+            cache.get("one");
+            cache.put(std::make_pair(std::string{"three"}, 3));
+
+            THEN("The other item is evicted") {
+                CHECK(cache.contains("one"));
+                CHECK_FALSE(cache.contains("two"));
+            }
+        }
+
+        WHEN("An item is erased by a C string") {
+            CHECK(cache.erase("one"));
+
+            THEN("It is removed") {
+                CHECK_FALSE(cache.contains(std::string{"one"}));
+                CHECK(cache.size() == 1);
+            }
+        }
+
+        WHEN("An item is updated by a C string") {
+            CHECK(cache.update("one", [](int& value) { value *= 10; }));
+
+            THEN("Its value is modified") { CHECK(cache.get("one") == 10); }
+        }
+    }
+}
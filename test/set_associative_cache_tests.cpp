@@ -0,0 +1,270 @@
+#define CATCH_CONFIG_MAIN
+
+#include <catch2/catch_test_macros.hpp>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include "bjg/set_associative_cache.hpp"
+
+// Value whose copies throw while armed
+struct throwing_value {
+    static bool armed;
+    std::string text;
+
+    explicit throwing_value(std::string arg_text) : text{std::move(arg_text)} {}
+    throwing_value(const throwing_value& other) : text{other.text} {
+        if (armed) throw std::runtime_error{"copy failed"};
+    }
+    throwing_value& operator=(const throwing_value& other) = default;
+};
+
+bool throwing_value::armed = false;
+
+// Hash whose moves may throw, as it declares no noexcept move
+struct copy_only_hash {
+    copy_only_hash() = default;
+    copy_only_hash(const copy_only_hash&) {}
+    copy_only_hash& operator=(const copy_only_hash&) { return *this; }
+    std::size_t operator()(const int key) const { return std::hash<int>{}(key); }
+};
+
+SCENARIO("Round the capacity of a set associative cache up to whole sets", "[set_associative_cache_capacity]") {
+    GIVEN("Set associative caches with different ways") {
+        THEN("Their capacity is a power of two number of sets") {
+            CHECK(bjg::set_associative_cache<int, int, 8>{8}.capacity() == 8);
+            CHECK(bjg::set_associative_cache<int, int, 8>{100}.capacity() == 128);
+            CHECK(bjg::set_associative_cache<int, int, 4>{1}.capacity() == 4);
+            CHECK(bjg::set_associative_cache<int, int, 16>{1000}.capacity() == 1024);
+        }
+
+        THEN("A zero capacity throws a length_error exception") {
+            CHECK_THROWS_AS((bjg::set_associative_cache<int, int>{0}), std::length_error);
+        }
+    }
+}
+
+SCENARIO("Insert items into a single set and reach its ways", "[set_associative_cache_insert_items]") {
+    GIVEN("An empty set associative cache with key:int, value:std::string and a single set of 4 ways") {
+        using cache_t = bjg::set_associative_cache<int, std::string, 4>;
+        cache_t cache{4};
+
+        CHECK(cache.empty());
+
+        WHEN("Five items are inserted") {
+            for (int i = 1; i <= 5; ++i) cache.put(std::make_pair(i, std::to_string(i)));
+
+            THEN("The least recent item of the set is evicted") {
+                CHECK(cache.size() == 4);
+                CHECK_FALSE(cache.contains(1));
+                CHECK(cache.get(2) == "2");
+                CHECK(cache.get(5) == "5");
+                CHECK_THROWS_AS(cache.get(1), std::out_of_range);
+            }
+        }
+
+        WHEN("Items are promoted, updated and peeked before a new item is inserted") {
+            for (int i = 1; i <= 4; ++i) cache.put(std::make_pair(i, std::to_string(i)));
+            cache.get(1);
+            cache.put(std::make_pair(2, "two"));
+            CHECK(*cache.peek(3) == "3");
+            cache.put(std::make_pair(5, "5"));
+
+            THEN("The least recent item which was neither promoted nor updated is evicted") {
+                CHECK_FALSE(cache.contains(3));
+                CHECK(cache.contains(4));
+                CHECK(cache.get(2) == "two");
+                CHECK(cache.try_get(3) == nullptr);
+            }
+        }
+
+        WHEN("Items are erased and new items take their place") {
+            for (int i = 1; i <= 4; ++i) cache.put(std::make_pair(i, std::to_string(i)));
+            CHECK(cache.erase(2));
+            CHECK_FALSE(cache.erase(2));
+            cache.put(std::make_pair(5, "5"));
+            cache.put(std::make_pair(6, "6"));
+
+            THEN("The remaining items keep their recency order") {
+                CHECK(cache.size() == 4);
+                CHECK_FALSE(cache.contains(1));
+                CHECK(cache.contains(3));
+                CHECK(cache.contains(4));
+                CHECK(cache.contains(6));
+            }
+        }
+
+        WHEN("The cache is cleared") {
+            for (int i = 1; i <= 4; ++i) cache.put(std::make_pair(i, std::to_string(i)));
+            cache.clear();
+            cache.put(std::make_pair(7, "7"));
+
+            THEN("Only the new item remains") {
+                CHECK(cache.size() == 1);
+                CHECK(cache.get(7) == "7");
+            }
+        }
+    }
+}
+
+SCENARIO("Keep the lru order of a single set under a random mix of operations", "[set_associative_cache_random_operations]") {
+    GIVEN("An empty set associative cache with key:int, value:int and a single set of 16 ways") {
+        bjg::set_associative_cache<int, int, 16> cache{16};
+        std::list<std::pair<int, int>> reference;
+        std::mt19937 generator{42};
+        std::uniform_int_distribution<int> keys{0, 40};
+
+        WHEN("Many items are inserted, erased and requested") {
+            for (int i = 0; i < 20000; ++i) {
+                const int key = keys(generator);
+                auto it = reference.begin();
+                while (it != reference.end() && it->first != key) ++it;
+
+                if (i % 3 == 0) {
+                    const int* value = cache.try_get(key);
+                    CHECK((value != nullptr) == (it != reference.end()));
+                    if (it != reference.end()) {
+                        CHECK(*value == it->second);
+                        reference.splice(reference.begin(), reference, it);
+                    }
+                } else if (i % 5 == 1) {
+                    CHECK(cache.erase(key) == (it != reference.end()));
+                    if (it != reference.end()) reference.erase(it);
+                } else {
+                    cache.put(std::make_pair(key, i));
+                    if (it != reference.end()) reference.erase(it);
+                    reference.emplace_front(key, i);
+                    if (reference.size() > 16) reference.pop_back();
+                }
+            }
+
+            THEN("The set holds exactly the most recent items") {
+                CHECK(cache.size() == reference.size());
+                for (const auto& item : reference) CHECK(*cache.peek(item.first) == item.second);
+            }
+        }
+    }
+}
+
+SCENARIO("Evict items from their own set only", "[set_associative_cache_sets]") {
+    GIVEN("An empty set associative cache with key:int, value:int and a capacity of 1024") {
+        bjg::set_associative_cache<int, int, 8> cache{1024};
+        std::unordered_map<int, int> latest;
+        std::mt19937 generator{7};
+        std::uniform_int_distribution<int> keys{0, 4000};
+
+        WHEN("Many more items are inserted than the cache can hold") {
+            for (int i = 0; i < 20000; ++i) {
+                const int key = keys(generator);
+                cache.put(std::make_pair(key, i));
+                latest[key] = i;
+                CHECK(cache.contains(key));
+            }
+
+            THEN("The cache is bounded by its capacity and every item it holds has its latest value") {
+                CHECK(cache.size() <= cache.capacity());
+                CHECK(cache.size() > cache.capacity() / 2);
+                std::size_t found = 0;
+                for (const auto& item : latest) {
+                    const int* value = cache.peek(item.first);
+                    if (value == nullptr) continue;
+                    CHECK(*value == item.second);
+                    ++found;
+                }
+                CHECK(found == cache.size());
+            }
+        }
+    }
+}
+
+SCENARIO("Copy and move a set associative cache", "[set_associative_cache_copy_move]") {
+    GIVEN("A set associative cache with key:int, value:std::string and size = 100") {
+        using cache_t = bjg::set_associative_cache<int, std::string, 8>;
+        cache_t cache{256};
+        for (int i = 0; i < 100; ++i) cache.put(std::make_pair(i, std::to_string(i)));
+        const auto size = cache.size();
+
+        WHEN("The cache is copied and the copy is modified") {
+            cache_t copy{cache};
+            const auto copied_size = copy.size();
+            copy.clear();
+            copy.put(std::make_pair(1000, "thousand"));
+
+            THEN("The copy had the same items and the original is unchanged") {
+                CHECK(copied_size == size);
+                CHECK(copy.size() == 1);
+                CHECK(copy.get(1000) == "thousand");
+                CHECK(cache.size() == size);
+                CHECK_FALSE(cache.contains(1000));
+                for (int i = 0; i < 100; ++i) {
+                    if (cache.contains(i)) CHECK(cache.get(i) == std::to_string(i));
+                }
+            }
+        }
+
+        WHEN("The cache is moved into another one") {
+            cache_t moved{1};
+            moved = std::move(cache);
+            cache.put(std::make_pair(1, "one"));
+
+            THEN("The items are moved and the moved-from cache can be used again") {
+                CHECK(moved.size() == size);
+                CHECK(moved.capacity() == 256);
+                CHECK(cache.size() == 1);
+                CHECK(cache.get(1) == "one");
+            }
+        }
+    }
+
+    GIVEN("Set associative caches whose hash function can or cannot throw when it is moved") {
+        using cache_t = bjg::set_associative_cache<int, std::string, 8>;
+        using throwing_cache_t = bjg::set_associative_cache<int, std::string, 8, copy_only_hash>;
+
+        THEN("Only the caches whose hash function cannot throw are moved without throwing") {
+            CHECK(std::is_nothrow_move_constructible<cache_t>::value);
+            CHECK(std::is_nothrow_move_assignable<cache_t>::value);
+            CHECK_FALSE(std::is_nothrow_move_constructible<throwing_cache_t>::value);
+            CHECK_FALSE(std::is_nothrow_move_assignable<throwing_cache_t>::value);
+        }
+    }
+}
+
+SCENARIO("Throw exceptions when adding items to a set associative cache", "[set_associative_cache_put_exception_safety]") {
+    GIVEN("A full set associative cache with key:int, value:throwing_value and a single set of 4 ways") {
+        bjg::set_associative_cache<int, throwing_value, 4> cache{4};
+        throwing_value::armed = false;
+        for (int i = 1; i <= 4; ++i) cache.put(std::make_pair(i, throwing_value{std::to_string(i)}));
+
+        WHEN("Copying a new value throws") {
+            const std::pair<const int, throwing_value> item{5, throwing_value{"5"}};
+            throwing_value::armed = true;
+            CHECK_THROWS_AS(cache.put(item), std::runtime_error);
+            throwing_value::armed = false;
+
+            THEN("No item is evicted") {
+                CHECK(cache.size() == 4);
+                CHECK_FALSE(cache.contains(5));
+                for (int i = 1; i <= 4; ++i) CHECK(cache.get(i).text == std::to_string(i));
+            }
+        }
+
+        WHEN("Copying an updated value throws") {
+            const std::pair<const int, throwing_value> item{2, throwing_value{"two"}};
+            throwing_value::armed = true;
+            CHECK_THROWS_AS(cache.put(item), std::runtime_error);
+            throwing_value::armed = false;
+            cache.put(std::make_pair(5, throwing_value{"5"}));
+
+            THEN("The item keeps its value and its recency") {
+                CHECK_FALSE(cache.contains(1));
+                CHECK(cache.get(2).text == "2");
+            }
+        }
+    }
+}
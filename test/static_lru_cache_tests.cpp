@@ -0,0 +1,271 @@
+#define CATCH_CONFIG_MAIN
+
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "bjg/static_lru_cache.hpp"
+
+struct throwing_key {
+    int value{0};
+
+    explicit throwing_key(const int arg_value) : value{arg_value} {}
+    bool operator==(const throwing_key& other) const { return value == other.value; }
+};
+
+struct invalid_hashing_argument : public std::exception {};
+
+// Dummy fault injection: while armed, hashing a negative key throws
+bool invalid_hashing_armed = false;
+
+namespace std {
+template <>
+struct hash<throwing_key> {
+    size_t operator()(const throwing_key& x) const {
+        if (x.value < 0 && invalid_hashing_armed) throw invalid_hashing_argument{};
+
+        return hash<int>()(x.value);
+    }
+};
+}  // namespace std
+
+static_assert(std::is_same<bjg::static_lru_cache<int, int, 100>::items_list_index, std::uint16_t>::value,
+              "Small caches use 16 bit links");
+static_assert(std::is_same<bjg::static_lru_cache<int, int, 65534>::items_list_index, std::uint32_t>::value,
+              "Caches which need more than 65534 nodes use 32 bit links");
+
+SCENARIO("Insert items into a static lru cache and reach capacity", "[static_lru_cache_insert_items]") {
+    GIVEN("An empty static lru cache with key:int, value:std::string, capacity = 3") {
+        using lru_cache_t = bjg::static_lru_cache<int, std::string, 3>;
+        lru_cache_t cache;
+
+        CHECK(lru_cache_t::capacity == 3);
+        CHECK(cache.empty());
+
+        WHEN("Four items are inserted") {
+            cache.put(std::make_pair(1, "one"));
+            cache.put(std::make_pair(2, "two"));
+            cache.put(std::make_pair(3, "three"));
+            cache.put(std::make_pair(4, "four"));
+
+            THEN("The least recent item is evicted") {
+                CHECK(cache.size() == 3);
+                CHECK_FALSE(cache.contains(1));
+                CHECK(cache.get(2) == "two");
+                CHECK(cache.get(3) == "three");
+                CHECK(cache.get(4) == "four");
+                CHECK_THROWS_AS(cache.get(1), std::out_of_range);
+            }
+        }
+
+        WHEN("An item is promoted before a new item is inserted") {
+            cache.put(std::make_pair(1, "one"));
+            cache.put(std::make_pair(2, "two"));
+            cache.put(std::make_pair(3, "three"));
+            cache.get(1);
+            cache.put(std::make_pair(4, "four"));
+
+            THEN("The next least recent item is evicted") {
+                CHECK(cache.contains(1));
+                CHECK_FALSE(cache.contains(2));
+            }
+        }
+
+        WHEN("Items are erased and new items take their place") {
+            cache.put(std::make_pair(1, "one"));
+            cache.put(std::make_pair(2, "two"));
+            cache.put(std::make_pair(3, "three"));
+            CHECK(cache.erase(2));
+            cache.put(std::make_pair(4, "four"));
+
+            THEN("No item is evicted") {
+                CHECK(cache.size() == 3);
+                CHECK(cache.contains(1));
+                CHECK(cache.contains(3));
+                CHECK(cache.contains(4));
+            }
+        }
+    }
+}
+
+SCENARIO("Copy and move a static lru cache", "[static_lru_cache_copy_move]") {
+    GIVEN("A static lru cache with handles, key:int, value:std::string, size = 3 and capacity = 4") {
+        using lru_cache_t = bjg::static_lru_cache<int, std::string, 4, std::hash<int>, std::equal_to<int>, true>;
+        lru_cache_t cache;
+        cache.put(std::make_pair(1, "one"));
+        cache.put(std::make_pair(2, "two"));
+        cache.put(std::make_pair(3, "three"));
+
+        WHEN("The lru cache is copied and the copy is modified") {
+            lru_cache_t copy{cache};
+            copy.put(std::make_pair(4, "four"));
+            copy.put(std::make_pair(5, "five"));
+
+            THEN("The copy keeps the recency order, independently of the original") {
+                CHECK(copy.size() == 4);
+                CHECK_FALSE(copy.contains(1));
+                CHECK(copy.get(2) == "two");
+                CHECK(cache.size() == 3);
+                CHECK(cache.get(1) == "one");
+                CHECK_FALSE(cache.contains(5));
+            }
+        }
+
+        WHEN("The lru cache is moved into another one") {
+            lru_cache_t other;
+            other.put(std::make_pair(9, "nine"));
+            other = std::move(cache);
+
+            THEN("The items are moved and the original is left empty") {
+                CHECK(other.size() == 3);
+                CHECK_FALSE(other.contains(9));
+                CHECK(other.get(3) == "three");
+                CHECK(cache.empty());
+                cache.put(std::make_pair(5, "five"));
+                CHECK(cache.get(5) == "five");
+            }
+        }
+
+        WHEN("The lru cache is moved into a new one, with a handle of one of its items") {
+            const auto handle = cache.find(2);
+            lru_cache_t moved{std::move(cache)};
+
+            THEN("The new lru cache accepts the handle, the emptied one does not") {
+                CHECK(moved.get(handle) == "two");
+                CHECK_FALSE(cache.contains(handle));
+                CHECK(cache.put(std::make_pair(2, "other two")));
+                CHECK_FALSE(cache.contains(handle));
+            }
+        }
+
+        WHEN("Both lru caches are cleared, then one is refilled and assigned to the other") {
+            lru_cache_t other;
+            other.put(std::make_pair(7, "seven"));
+            other.put(std::make_pair(8, "eight"));
+            other.clear();
+            cache.clear();
+            cache.put(std::make_pair(6, "a value which does not fit the small string buffer"));
+            other = cache;
+
+            THEN("The copy holds only the items put after the clear") {
+                CHECK(other.size() == 1);
+                CHECK_FALSE(other.contains(8));
+                CHECK(other.get(6) == "a value which does not fit the small string buffer");
+                CHECK_FALSE(cache.contains(1));
+            }
+        }
+    }
+}
+
+SCENARIO("Keep evicted items of a static lru cache in a graveyard", "[static_lru_cache_graveyard]") {
+    GIVEN("A full static lru cache with key:int, value:std::string, capacity = 3 and a graveyard of 2 items") {
+        using lru_cache_t = bjg::static_lru_cache<int, std::string, 3>;
+        lru_cache_t cache;
+        cache.set_graveyard_capacity(2);
+        cache.put(std::make_pair(1, "one"));
+        cache.put(std::make_pair(2, "two"));
+        cache.put(std::make_pair(3, "three"));
+
+        WHEN("New items are put") {
+            cache.put(std::make_pair(4, "four"));
+            cache.put(std::make_pair(5, "five"));
+            cache.put(std::make_pair(6, "six"));
+
+            THEN("The inline nodes of the graveyard are reused, as there is no room beyond the capacity") {
+                CHECK(cache.size() == 3);
+                CHECK(cache.graveyard_size() <= 1);
+                CHECK(cache.get(4) == "four");
+                CHECK(cache.get(6) == "six");
+                CHECK_FALSE(cache.contains(3));
+            }
+        }
+    }
+}
+
+SCENARIO("Throw exceptions when adding items to a static lru cache", "[static_lru_cache_put_exception_safety]") {
+    GIVEN("A full static lru cache with key:throwing_key, value:std::string, capacity = 2") {
+        using lru_cache_t = bjg::static_lru_cache<throwing_key, std::string, 2>;
+        lru_cache_t cache;
+        cache.put(std::make_pair(throwing_key{1}, "one"));
+        cache.put(std::make_pair(throwing_key{2}, "two"));
+
+        WHEN("Hashing fails during insertion") {
+            invalid_hashing_armed = true;
+            CHECK_THROWS_AS(cache.put(std::make_pair(throwing_key{-1}, "invalid")), invalid_hashing_argument);
+            invalid_hashing_armed = false;
+
+            THEN("The cache does not change") {
+                CHECK(cache.size() == 2);
+                CHECK(cache.get(throwing_key{1}) == "one");
+                CHECK(cache.get(throwing_key{2}) == "two");
+            }
+        }
+    }
+}
+
+SCENARIO("Keep the lru order of a static lru cache under a random mix of operations", "[static_lru_cache_random_operations]") {
+    GIVEN("An empty static lru cache with key:int, value:int, capacity = 100") {
+        bjg::static_lru_cache<int, int, 100> cache;
+        std::list<std::pair<int, int>> reference;
+        std::mt19937 generator{7};
+        std::uniform_int_distribution<int> keys{0, 499};
+
+        WHEN("Many items are inserted, erased and requested") {
+            for (int i = 0; i < 20000; ++i) {
+                const auto key = keys(generator);
+                auto it = reference.begin();
+                while (it != reference.end() && it->first != key) ++it;
+
+                if (i % 3 == 0) {
+                    CHECK(cache.contains(key) == (it != reference.end()));
+                    if (it != reference.end()) {
+                        CHECK(cache.get(key) == it->second);
+                        reference.splice(reference.begin(), reference, it);
+                    }
+                } else if (i % 5 == 1) {
+                    CHECK(cache.erase(key) == (it != reference.end()));
+                    if (it != reference.end()) reference.erase(it);
+                } else {
+                    cache.put(std::make_pair(key, i));
+                    if (it != reference.end()) reference.erase(it);
+                    reference.emplace_front(key, i);
+                    if (reference.size() > 100) reference.pop_back();
+                }
+            }
+
+            THEN("The lru cache holds exactly the most recent items") {
+                CHECK(cache.size() == reference.size());
+                for (const auto& item : reference) {
+                    REQUIRE(cache.peek(item.first) != nullptr);
+                    CHECK(*cache.peek(item.first) == item.second);
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Store move-only values in a static lru cache", "[static_lru_cache_move_only]") {
+    GIVEN("A static lru cache with key:int, value:std::unique_ptr<int>, capacity = 2") {
+        bjg::static_lru_cache<int, std::unique_ptr<int>, 2> cache;
+
+        WHEN("Values are put and emplaced, then the cache is moved") {
+            cache.put(std::make_pair(1, std::unique_ptr<int>{new int{1}}));
+            cache.emplace(2, new int{2});
+            cache.try_emplace(3, new int{3});
+            const auto moved = std::move(cache);
+
+            THEN("The moved cache owns the most recent values") {
+                CHECK(moved.size() == 2);
+                CHECK_FALSE(moved.contains(1));
+                CHECK(**moved.peek(2) == 2);
+                CHECK(**moved.peek(3) == 3);
+            }
+        }
+    }
+}